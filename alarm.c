@@ -1,208 +1,211 @@
-/*
- * alarm.c
- *
- *  Created on: Sep 29, 2025
- *      Author: bguer053
- */
-
-
-// Alarm system app
-#include <stdio.h>
-#include <stdbool.h>
-#include "alarm.h"
-#include "systick.h"
-#include "gpio.h"
-#include "display.h"
-
-// Macros for LED control using GPIO driver
-#define LED_Set(pin)    GPIO_Output(pin, HIGH)
-#define LED_Clear(pin)  GPIO_Output(pin, LOW)
-#define LED_Toggle(pin) GPIO_Toggle(pin)
-
-// GPIO pins
-static const Pin_t LedR = {GPIOA, 9};
-static const Pin_t LedG = {GPIOC, 7};
-static const Pin_t LedB = {GPIOB, 7};
-static const Pin_t Button = {GPIOB, 2};
-static const Pin_t Motion = {GPIOB, 9};
-
-// Alarm states
-static enum { DISARMED, ARMED, TRIGGERED } state;
-
-// Constants
-#define DEBOUNCE_MS        50u
-#define BRIEF_PRESS_MAX_MS 2000u
-#define LONG_PRESS_MS      3000u
-#define LED_TOGGLE_MS      1000u
-#define TASK_TICK_MS       1u
-
-// Variables
-static bool motionFlag = false;
-static bool buttonPressedFlag = false;
-static bool buttonBriefFlag = false;
-static uint32_t lastButtonPressTime = 0;
-static uint32_t lastButtonReleaseTime = 0;
-static uint32_t armedSince = 0;
-static uint32_t ledToggleSince = 0;
-static bool ledStateGB = false;
-
-// Callback prototypes
-static void CallbackMotionDetect(void);
-static void CallbackButtonPress(void);
-static void CallbackButtonRelease(void);
-
-// Initialization
-void Init_Alarm(void) {
-    state = DISARMED;
-
-    motionFlag = false;
-    buttonPressedFlag = false;
-    buttonBriefFlag = false;
-    lastButtonPressTime = 0;
-    lastButtonReleaseTime = 0;
-    armedSince = 0;
-
-    GPIO_Enable(LedR); GPIO_Mode(LedR, OUTPUT);
-    GPIO_Enable(LedG); GPIO_Mode(LedG, OUTPUT);
-    GPIO_Enable(LedB); GPIO_Mode(LedB, OUTPUT);
-
-    LED_Clear(LedR);
-    LED_Clear(LedG);
-    LED_Clear(LedB);
-
-    GPIO_Enable(Motion);
-    GPIO_Mode(Motion, INPUT);
-
-    GPIO_Enable(Button);
-    GPIO_Mode(Button, INPUT);
-
-    GPIO_Callback(Motion, CallbackMotionDetect, RISE);
-    GPIO_Callback(Button, CallbackButtonPress, RISE);
-    GPIO_Callback(Button, CallbackButtonRelease, FALL);
-
-    DisplayEnable();
-    DisplayColor(ALARM, WHITE);
-    DisplayPrint(ALARM, 0, "DISARMED");
-}
-
-// Task (state machine)
-void Task_Alarm(void) {
-    uint32_t now = TimeNow();
-
-    switch (state) {
-    case DISARMED:
-        LED_Clear(LedR);
-        LED_Clear(LedG);
-        LED_Clear(LedB);
-        DisplayColor(ALARM, WHITE);
-        DisplayPrint(ALARM, 0, "DISARMED");
-
-        if (buttonBriefFlag) {
-            buttonBriefFlag = 0;
-            state = ARMED;
-            armedSince = now;
-            ledToggleSince = now;
-            ledStateGB = false;
-            LED_Set(LedG);
-            LED_Clear(LedB);
-
-        }
-        break;
-
-    case ARMED:
-    	DisplayColor(ALARM, YELLOW);
-    	DisplayPrint(ALARM, 0, "ARMED");
-        if (buttonPressedFlag) {
-            uint32_t held = now - lastButtonPressTime;
-            if (held >= LONG_PRESS_MS) {
-                buttonPressedFlag = 0;
-                buttonBriefFlag = 0;
-                state = DISARMED;
-
-
-            }
-        }
-
-        if ((now - ledToggleSince) >= LED_TOGGLE_MS) {
-            ledToggleSince = now;
-            ledStateGB = !ledStateGB;
-            if (ledStateGB) {
-                LED_Clear(LedG);
-                LED_Set(LedB);
-            } else {
-                LED_Set(LedG);
-                LED_Clear(LedB);
-            }
-        }
-
-        if (motionFlag) {
-            motionFlag = 0;
-            state = TRIGGERED;
-            LED_Set(LedR);
-            LED_Clear(LedG);
-            LED_Clear(LedB);
-
-        }
-        break;
-
-    case TRIGGERED:
-        LED_Set(LedR);
-        LED_Clear(LedG);
-        LED_Clear(LedB);
-        DisplayColor(ALARM, RED);
-        DisplayPrint(ALARM, 0, "TRIGGERED");
-
-        if (buttonBriefFlag) {
-            buttonBriefFlag = 0;
-            state = ARMED;
-            armedSince = now;
-            ledToggleSince = now;
-            ledStateGB = false;
-            LED_Set(LedG);
-            LED_Clear(LedR);
-
-        }
-
-        if (buttonPressedFlag) {
-            uint32_t held = now - lastButtonPressTime;
-            if (held >= LONG_PRESS_MS) {
-                buttonPressedFlag = 0;
-                buttonBriefFlag = 0;
-                state = DISARMED;
-                LED_Set(LedR);
-                LED_Clear(LedG);
-                LED_Clear(LedB);
-            }
-        }
-        break;
-
-    default:
-        state = DISARMED;
-        LED_Set(LedR);
-        LED_Clear(LedG);
-        LED_Clear(LedB);
-        break;
-    }
-}
-
-// ------------------------------------------------------------
-// Interrupt callback functions
-// ------------------------------------------------------------
-void CallbackMotionDetect(void) {
-    motionFlag = true;
-}
-
-void CallbackButtonPress(void) {
-    lastButtonPressTime = TimeNow();
-    buttonPressedFlag = true;
-}
-
-void CallbackButtonRelease(void) {
-    uint32_t now = TimeNow();
-    if ((now - lastButtonPressTime) < BRIEF_PRESS_MAX_MS)
-        buttonBriefFlag = true;
-    buttonPressedFlag = false;
-}
-
-
-
+/*
+ * alarm.c
+ *
+ *  Created on: Sep 29, 2025
+ *      Author: bguer053
+ */
+
+
+// Alarm system app
+#include <stdio.h>
+#include <stdbool.h>
+#include "alarm.h"
+#include "systick.h"
+#include "gpio.h"
+#include "display.h"
+
+// Macros for LED control using GPIO driver
+#define LED_Set(pin)    GPIO_Output(pin, HIGH)
+#define LED_Clear(pin)  GPIO_Output(pin, LOW)
+#define LED_Toggle(pin) GPIO_Toggle(pin)
+
+// GPIO pins
+static const Pin_t LedR = {GPIOA, 9};
+static const Pin_t LedG = {GPIOC, 7};
+static const Pin_t LedB = {GPIOB, 7};
+static const Pin_t Button = {GPIOB, 2};
+static const Pin_t Motion = {GPIOB, 9};
+
+// Alarm states
+static enum { DISARMED, ARMED, TRIGGERED } state;
+
+// Constants
+#define DEBOUNCE_MS        50u
+#define BRIEF_PRESS_MAX_MS 2000u
+#define LONG_PRESS_MS      3000u
+#define LED_TOGGLE_MS      1000u
+#define TASK_TICK_MS       1u
+
+// Variables
+static bool motionFlag = false;
+static bool buttonPressedFlag = false;
+static bool buttonBriefFlag = false;
+static bool buttonEdgeFlag = false;
+static uint32_t lastButtonPressTime = 0;
+static uint32_t lastButtonReleaseTime = 0;
+static uint32_t armedSince = 0;
+static Timer_t ledTimer; // Alternates green and blue while armed
+static Timer_t holdTimer; // Runs while the button is held, disarms on expiry
+static bool ledStateGB = false;
+
+// Callback prototypes
+static void CallbackMotionDetect(void);
+static void CallbackButtonPress(void);
+static void CallbackButtonRelease(void);
+static void CallbackLedToggle(Timer_t *t);
+static void CallbackLongPress(Timer_t *t);
+
+// Initialization
+void Init_Alarm(void) {
+    state = DISARMED;
+
+    motionFlag = false;
+    buttonPressedFlag = false;
+    buttonBriefFlag = false;
+    buttonEdgeFlag = false;
+    lastButtonPressTime = 0;
+    lastButtonReleaseTime = 0;
+    armedSince = 0;
+
+    GPIO_Enable(LedR); GPIO_Mode(LedR, OUTPUT);
+    GPIO_Enable(LedG); GPIO_Mode(LedG, OUTPUT);
+    GPIO_Enable(LedB); GPIO_Mode(LedB, OUTPUT);
+
+    LED_Clear(LedR);
+    LED_Clear(LedG);
+    LED_Clear(LedB);
+
+    GPIO_Enable(Motion);
+    GPIO_Mode(Motion, INPUT);
+
+    GPIO_Enable(Button);
+    GPIO_Mode(Button, INPUT);
+
+    GPIO_Callback(Motion, CallbackMotionDetect, RISE);
+    GPIO_Callback(Button, CallbackButtonPress, RISE);
+    GPIO_Callback(Button, CallbackButtonRelease, FALL);
+
+    DisplayEnable();
+    DisplayColor(ALARM, WHITE);
+    DisplayPrint(ALARM, 0, "DISARMED");
+}
+
+// State changes: LEDs and display are set once on entry
+static void Disarm(void) {
+    state = DISARMED;
+    TimerStop(&ledTimer);
+    LED_Clear(LedR);
+    LED_Clear(LedG);
+    LED_Clear(LedB);
+    DisplayColor(ALARM, WHITE);
+    DisplayPrint(ALARM, 0, "DISARMED");
+}
+
+static void Arm(void) {
+    state = ARMED;
+    armedSince = TimeNow();
+    motionFlag = false; // Motion before arming does not count
+    TimerStart(&ledTimer, LED_TOGGLE_MS, LED_TOGGLE_MS, CallbackLedToggle);
+    ledStateGB = false;
+    LED_Clear(LedR);
+    LED_Set(LedG);
+    LED_Clear(LedB);
+    DisplayColor(ALARM, YELLOW);
+    DisplayPrint(ALARM, 0, "ARMED");
+}
+
+static void Trigger(void) {
+    state = TRIGGERED;
+    TimerStop(&ledTimer);
+    LED_Set(LedR);
+    LED_Clear(LedG);
+    LED_Clear(LedB);
+    DisplayBlink(ALARM, RED, 500);
+    DisplayPrint(ALARM, 0, "TRIGGERED");
+}
+
+// Work for Task_Alarm: a button edge, or motion while armed
+bool Ready_Alarm(void) {
+    return buttonEdgeFlag || buttonBriefFlag || (state == ARMED && motionFlag);
+}
+
+// Task (state machine)
+void Task_Alarm(void) {
+    // Button held: a long press disarms when the hold timer expires
+    if (buttonEdgeFlag) {
+        buttonEdgeFlag = false;
+        if (buttonPressedFlag) {
+            uint32_t held = TimePassed(lastButtonPressTime);
+            TimerStart(&holdTimer, held < LONG_PRESS_MS ? LONG_PRESS_MS - held : 0, 0, CallbackLongPress);
+        } else {
+            TimerStop(&holdTimer);
+        }
+    }
+    bool brief = buttonBriefFlag;
+    buttonBriefFlag = false;
+
+    switch (state) {
+    case DISARMED:
+        if (brief)
+            Arm();
+        break;
+
+    case ARMED:
+        if (motionFlag)
+            Trigger();
+        break;
+
+    case TRIGGERED:
+        if (brief)
+            Arm();
+        break;
+
+    default:
+        Disarm();
+        break;
+    }
+}
+
+// ------------------------------------------------------------
+// Interrupt callback functions
+// ------------------------------------------------------------
+void CallbackMotionDetect(void) {
+    motionFlag = true;
+}
+
+void CallbackButtonPress(void) {
+    lastButtonPressTime = TimeNow();
+    buttonPressedFlag = true;
+    buttonEdgeFlag = true;
+}
+
+void CallbackButtonRelease(void) {
+    uint32_t now = TimeNow();
+    if ((now - lastButtonPressTime) < BRIEF_PRESS_MAX_MS)
+        buttonBriefFlag = true;
+    buttonPressedFlag = false;
+    buttonEdgeFlag = true;
+}
+
+// Timer callback while armed, called from ServiceTimers
+void CallbackLedToggle(Timer_t *t) {
+    (void)t;
+    ledStateGB = !ledStateGB;
+    if (ledStateGB) {
+        LED_Clear(LedG);
+        LED_Set(LedB);
+    } else {
+        LED_Set(LedG);
+        LED_Clear(LedB);
+    }
+}
+
+// Button held LONG_PRESS_MS, called from ServiceTimers
+void CallbackLongPress(Timer_t *t) {
+    (void)t;
+    if (state != DISARMED)
+        Disarm();
+}
+
+
+
@@ -0,0 +1,18 @@
+/*
+ * alarm.h
+ *
+ *  Created on: Sep 29, 2025
+ *      Author: bguer053
+ */
+
+#ifndef ALARM_H_
+#define ALARM_H_
+
+#include <stdbool.h>
+
+void Init_Alarm();
+void Task_Alarm();
+bool Ready_Alarm(void);
+
+
+#endif /* ALARM_H_ */
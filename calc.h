@@ -0,0 +1,17 @@
+/*
+ * calc.h
+ *
+ *  Created on: Nov 3, 2025
+ *      Author: knguy138
+ */
+
+#ifndef CALC_H_
+#define CALC_H_
+
+#include <stdbool.h>
+
+void Init_Calc(void);
+void Task_Calc(void);
+bool Ready_Calc(void);
+
+#endif /* CALC_H_ */
@@ -1,13 +1,39 @@
-/*
- * debug.c
- *
- *  Created on: Sep 22, 2025
- *      Author: bguer053
- */
-
-#include "stm32l5xx.h"
-
-int __io_putchar(int c) {
-	ITM_SendChar(c);
-	return c;
-}
+/*
+ * debug.c
+ *
+ *  Created on: Sep 22, 2025
+ *      Author: bguer053
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "stm32l5xx.h"
+#include "i2c.h"
+#include "profile.h"
+
+int __io_putchar(int c) {
+	ITM_SendChar(c);
+	return c;
+}
+
+// Print I2C bus statistics, one line per target device
+void I2C_DumpStats(void) {
+	I2C_Stats_t snap[I2C_STATS_DEVICES];
+	int devices = I2C_GetStats(snap);
+	printf("addr xfers bytes errs wait(ms)   svc(cyc) max(ms)\n"); // 0xFF: other devices
+	for (int i = 0; i < devices; i++)
+		printf("0x%02X %5" PRIu32 " %5" PRIu32 " %4" PRIu32 " %8" PRIu32
+				" %10" PRIu64 " %7" PRIu32 "\n", snap[i].addr,
+				snap[i].transfers, snap[i].bytes, snap[i].errors,
+				snap[i].waitTime, snap[i].serviceCycles, snap[i].maxLatency);
+}
+
+// Print execution time profiles, one line per profile
+void ProfileDump(const Profile_t *p, int n) {
+	printf("task         calls    min    avg    max overruns\n");
+	for (int i = 0; i < n; i++)
+		printf("%-10s %7" PRIu32 " %6" PRIu32 " %6" PRIu32 " %6" PRIu32 " %8" PRIu32 "\n",
+				p[i].name, p[i].calls, p[i].min,
+				p[i].calls ? (uint32_t)(p[i].total / p[i].calls) : 0,
+				p[i].max, p[i].overruns);
+}
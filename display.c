@@ -1,162 +1,564 @@
-/*
- * display.c
- *
- *  Created on: Oct 20, 2025
- *      Author: bguer053
- */
-
-
-// Display driver
-
-#include <stdint.h>
-#include <stdbool.h>
-#include <stddef.h>
-#include <stdio.h>
-#include <stdarg.h>
-#include "display.h"
-#include "i2c.h"
-#include "systick.h"
-#include "touchpad.h"
-bool enabled = false; // Initialization complete
-Page_t openPage = 0; // Currently displayed page
-static const Pin_t TouchEn = {GPIOB, 5}; // Pin PB5 <- Touch En button
-Time_t pressTime; // Timestamp of last button press
-#define DEBOUNCE_TIME 50 // 50ms debounce
-static void CallbackTouchEnPress(void);
-static void CallbackTouchEnRelease(void);
-// --------------------------------------------------------
-// Display controller
-// --------------------------------------------------------
-#define ROWS 2 // Number of rows
-#define COLS 16 // Number of columns
-uint8_t dispText[PAGES][ROWS][COLS+1];
-// Command word
-typedef struct {
- uint8_t ctrl; // Control byte
-uint8_t data; // Data byte
-} DispCmd_t;
-// Initialization command sequence
-static const DispCmd_t txInit[] = {
- {0x80, 0x28}, // Function Set: 2-line, display OFF
- {0x80, 0x0C}, // Display Control: display ON, cursor OFF, blink OFF
- {0x80, 0x01}, // Display Clear
- {0x80, 0x06} // Entry Mode Set: increment, no shift
-};
-// Display line
-typedef struct {
- DispCmd_t cmd; // Command word to set display line
- uint8_t ctrl; // Last control byte, data bytes to follow
- uint8_t text[COLS]; // ASCII text to write to display
-} DispLine_t;
-// Select display line and print text
-static DispLine_t txLine[ROWS] = {
- { {0x80, 0x80}, 0x40, {0} },
- { {0x80, 0xC0}, 0x40, {0} } };
-static bool updateLine[2] = {false, false};
-// I2C transfers
-static I2C_Xfer_t DispInit = {&LeafyI2C, 0x7C, (uint8_t *)&txInit, 8, 1};
-static I2C_Xfer_t DispLine[ROWS] = {
- {&LeafyI2C, 0x7C, (uint8_t *)&txLine[0], 19, 1},
- {&LeafyI2C, 0x7C, (uint8_t *)&txLine[1], 19, 1} };
-// Enable LCD display
-void DisplayEnable (void) {
- if (!enabled) {
- enabled = true;
- I2C_Enable(LeafyI2C);
- I2C_Request(&DispInit);
- // Blank out display text on all pages/rows
- for (int i = 0; i < PAGES ; i++)
- for (int j = 0; j < ROWS; j++)
- for (int k = 0; k < COLS ; k++)
- dispText[i][j][k] = ' ';
- // Use the Touch En button to cycle between display pages
- GPIO_Enable(TouchEn);
- GPIO_Mode(TouchEn, INPUT);
- GPIO_Callback(TouchEn, CallbackTouchEnPress, RISE);
- GPIO_Callback(TouchEn, CallbackTouchEnRelease, FALL);
- }
-}
-// Print a line of text with optional format specifiers
-void DisplayPrint (Page_t page, const int line, const char *msg, ...) {
- va_list args;
- va_start(args, msg);
- // Full buffer with formatted text and space pad the remainder
- int chars = vsnprintf((char *)dispText[page][line], COLS+1, msg, args);
- for (int i = chars; i < COLS; i++)
- dispText[page][line][i] = ' ';
- if (page == openPage)
- updateLine[line] = true;
-}
-// --------------------------------------------------------
-// Backlight controller
-// --------------------------------------------------------
-Color_t dispColor[PAGES] = {OFF, CYAN, MAGENTA, ORANGE};
-typedef struct {
- uint8_t addr; // Address byte
- uint8_t data; // Data byte
-} BltCmd_t;
-// Transmit data buffers to set brightness of each LED, all off by default
-static BltCmd_t txRed = {0x01, 0x00};
-static BltCmd_t txGreen = {0x02, 0x00};
-static BltCmd_t txBlue = {0x03, 0x00};
-static bool updateBlt = true;
-// I2C transfers
-static I2C_Xfer_t BltRed = {&LeafyI2C, 0x5A, (void *)&txRed, 2, 1};
-static I2C_Xfer_t BltGreen = {&LeafyI2C, 0x5A, (void *)&txGreen, 2, 1};
-static I2C_Xfer_t BltBlue = {&LeafyI2C, 0x5A, (void *)&txBlue, 2, 1};
-// Set new backlight color
-void DisplayColor(const Page_t page, const Color_t color) {
- dispColor[page] = color;
- if (page == openPage)
- updateBlt = true;
-}
-// --------------------------------------------------------
-// Automatic background updates
-// --------------------------------------------------------
-// Called from main loop
-void UpdateDisplay(void) {
- // Update display text
- for (int j = 0; j < ROWS; j++)
- if (!DispLine[j].busy && updateLine[j]) {
- updateLine[j] = false;
- // Copy text into buffer
- for (int k = 0; k < COLS; k++)
- txLine[j].text[k] = dispText[openPage][j][k];
- I2C_Request(&DispLine[j]);
- }
- // Update backlight
- if (!BltBlue.busy && updateBlt) {
- updateBlt = false;
- // Extract individual color bytes
- Color_t color = dispColor[openPage];
- txRed .data = (color >> 16) & 0xFF;
- txGreen.data = (color >> 8) & 0xFF;
- txBlue .data = (color >> 0) & 0xFF;
- I2C_Request(&BltRed);
- I2C_Request(&BltGreen);
- I2C_Request(&BltBlue);
- }
-}
-// --------------------------------------------------------
-// Page switching
-// --------------------------------------------------------
-// Obtain the currently displayed page
-Page_t GetPage (void) {
- return openPage;
-}
-static void CallbackTouchEnPress (void) {
- pressTime = TimeNow();
-}
-static void CallbackTouchEnRelease (void) {
- Time_t heldTime = TimePassed(pressTime);
- if (heldTime > DEBOUNCE_TIME) {
- // Switch to next page
- openPage++;
- openPage %= PAGES;
- // Force update of display text and backlight color
- for (int i = 0; i < ROWS; i++)
- updateLine[i] = true;
- updateBlt = true;
- ClearTouchpad(); // Discard input buffer
- }
-}
+/*
+ * display.c
+ *
+ *  Created on: Oct 20, 2025
+ *      Author: bguer053
+ */
+
+
+// Display driver
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include "display.h"
+#include "i2c.h"
+#include "systick.h"
+bool enabled = false; // Initialization complete
+Page_t openPage = 0; // Currently displayed page
+static const Pin_t TouchEn = {GPIOB, 5}; // Pin PB5 <- Touch En button
+#define DEBOUNCE_TIME 50 // 50ms debounce
+static volatile bool touchEnEdge = false; // Button changed since last checked
+static bool touchEnDown = false; // Button level after debouncing
+static Timer_t touchEnTimer; // Samples the button once it has settled
+static void CallbackTouchEnEdge(void);
+static void CallbackTouchEnSettled(Timer_t *t);
+static void CallbackLineDone(I2C_Xfer_t *p);
+static void CallbackGlyphDone(I2C_Xfer_t *p);
+static void CallbackInitDone(I2C_Xfer_t *p);
+static void CallbackHomeDone(I2C_Xfer_t *p);
+static void CallbackShiftDone(I2C_Xfer_t *p);
+// --------------------------------------------------------
+// Display controller
+// --------------------------------------------------------
+#define ROWS 2 // Number of rows
+#define COLS 16 // Number of columns
+#define LINE_COLS 40 // Columns of display memory per row, visible when scrolled
+uint8_t dispText[PAGES][ROWS][LINE_COLS+1];
+// Shadow of the LCD contents; the open page is composed into it and the
+// changed characters are sent from here, so page text can be rewritten
+// while a line transfer is still in progress. A row of the shadow is only
+// changed once its previous write has gone out (lineSending), so it always
+// holds exactly what was put on the wire.
+static uint8_t lcdText[ROWS][LINE_COLS];
+// Command word
+typedef struct {
+ uint8_t ctrl; // Control byte
+uint8_t data; // Data byte
+} DispCmd_t;
+// Initialization command sequence, Clear last: the LCD ignores anything
+// else while it executes
+static const DispCmd_t txInit[] = {
+ {0x80, 0x28}, // Function Set: 2-line, display OFF
+ {0x80, 0x0C}, // Display Control: display ON, cursor OFF, blink OFF
+ {0x80, 0x06}, // Entry Mode Set: increment, no shift
+ {0x80, 0x01} // Display Clear
+};
+// Shift the whole display one column left, both rows move together
+static const DispCmd_t txShift = {0x80, 0x18};
+// Return Home: undo any display shift
+static const DispCmd_t txHome = {0x80, 0x02};
+// Display line header, text follows straight from the page buffer
+typedef struct {
+ DispCmd_t cmd; // Command word to set display line
+ uint8_t ctrl; // Last control byte, data bytes to follow
+} DispLine_t;
+// Select display line, DDRAM address adjusted to the first changed column
+static DispLine_t txLine[ROWS] = {
+ { {0x80, 0x80}, 0x40 },
+ { {0x80, 0xC0}, 0x40 } };
+// Line header and changed text, gathered into one transfer
+static I2C_Seg_t lineSegs[ROWS][2] = {
+ { {(uint8_t *)&txLine[0], sizeof(DispLine_t)}, {lcdText[0], COLS} },
+ { {(uint8_t *)&txLine[1], sizeof(DispLine_t)}, {lcdText[1], COLS} } };
+static bool updateLine[2] = {false, false};
+static volatile bool lineSending[ROWS]; // Line write queued, until its callback
+// Pending changes are sent in frames, DISPLAY_FRAME_MS apart and limited to
+// a number of bytes per frame so display traffic can't starve the other
+// devices on the bus
+#define FRAME_BYTES 48 // Bus bytes per frame, about 13% of the bus at 100 kHz
+#define LINE_BYTES (1 + (int)sizeof(DispLine_t)) // Address and line header
+#define BLT_BYTES (1 + (int)sizeof(BltCmd_t)) // Address and one backlight channel
+static uint32_t frames = 0; // Frames flushed
+static uint32_t framesDropped = 0; // Frames that could not be sent in full
+// Scrolling pages use all LINE_COLS columns of each row and are moved
+// through the COLS wide window with the display shift command
+#define CMD_BYTES (1 + (int)sizeof(DispCmd_t)) // Address and command word
+static uint16_t dispScroll[PAGES]; // Scroll step in ms, 0 for fixed text
+static int lcdShift = 0; // Columns the display is shifted by
+static bool rehome = false; // Restart scrolling from the first column
+static Time_t scrollTime; // Time the current scroll step started
+static volatile bool homeSending = false; // Return Home queued, until its callback
+// Clear and Return Home keep the LCD busy for 1.52 ms, bytes sent meanwhile
+// are dropped; the next writes wait until CLEAR_MS have passed
+#define CLEAR_MS 3 // Two full ticks at least
+static volatile bool initSending = false; // Initialization queued, until its callback
+static volatile Time_t clearTime; // Last Clear or Return Home went out
+static volatile bool shiftSending = false; // Shift queued, until its callback
+// I2C transfers
+static I2C_Xfer_t DispInit = {.bus = &LeafyI2C, .addr = 0x7C, .data = (uint8_t *)&txInit,
+ .size = sizeof(txInit), .stop = true, .done = CallbackInitDone, .prio = PRIO_DISPLAY};
+static I2C_Xfer_t DispShift = {.bus = &LeafyI2C, .addr = 0x7C, .data = (uint8_t *)&txShift,
+ .size = sizeof(txShift), .stop = true, .done = CallbackShiftDone, .prio = PRIO_DISPLAY};
+static I2C_Xfer_t DispHome = {.bus = &LeafyI2C, .addr = 0x7C, .data = (uint8_t *)&txHome,
+ .size = sizeof(txHome), .stop = true, .done = CallbackHomeDone, .prio = PRIO_DISPLAY};
+// Line writes are "latest value wins", keyed on the line command word
+#define LINE_XFER(j) {.bus = &LeafyI2C, .addr = 0x7C, .stop = true, .done = CallbackLineDone, \
+ .prio = PRIO_DISPLAY, .latest = true, .keySize = 2, .segs = lineSegs[j], .nSegs = 2}
+static I2C_Xfer_t DispLine[ROWS] = { LINE_XFER(0), LINE_XFER(1) };
+// --------------------------------------------------------
+// Custom glyphs
+// --------------------------------------------------------
+// The LCD's 8 CGRAM slots hold the most recently used glyphs, a glyph is
+// uploaded only when it is not already in a slot, into a slot no text uses. Slot n shows as
+// character code 8+n (same glyph as n, avoids a NUL in the text).
+#define GLYPH_SLOTS 8
+#define GLYPH_BYTES (1 + (int)sizeof(DispLine_t) + 8) // Address, header, pattern
+static const Glyph_t *glyphSlot[GLYPH_SLOTS]; // Glyph held in each slot
+static uint32_t glyphUsed[GLYPH_SLOTS]; // Last use of each slot
+static uint32_t glyphClock = 0; // Use counter for LRU replacement
+static bool updateGlyph[GLYPH_SLOTS]; // Slot waiting for upload
+static volatile bool glyphSending[GLYPH_SLOTS]; // Upload queued, until its callback
+// Set CGRAM address of the slot, pattern follows
+static DispLine_t txGlyph[GLYPH_SLOTS] = {
+ { {0x80, 0x40}, 0x40 }, { {0x80, 0x48}, 0x40 }, { {0x80, 0x50}, 0x40 }, { {0x80, 0x58}, 0x40 },
+ { {0x80, 0x60}, 0x40 }, { {0x80, 0x68}, 0x40 }, { {0x80, 0x70}, 0x40 }, { {0x80, 0x78}, 0x40 } };
+// Slot address and glyph pattern, gathered into one transfer
+#define GLYPH_SEGS(i) { {(uint8_t *)&txGlyph[i], sizeof(DispLine_t)}, {NULL, 8} }
+static I2C_Seg_t glyphSegs[GLYPH_SLOTS][2] = {
+ GLYPH_SEGS(0), GLYPH_SEGS(1), GLYPH_SEGS(2), GLYPH_SEGS(3),
+ GLYPH_SEGS(4), GLYPH_SEGS(5), GLYPH_SEGS(6), GLYPH_SEGS(7) };
+#define GLYPH_XFER(i) {.bus = &LeafyI2C, .addr = 0x7C, .stop = true, .done = CallbackGlyphDone, \
+ .prio = PRIO_DISPLAY, .segs = glyphSegs[i], .nSegs = 2}
+static I2C_Xfer_t DispGlyph[GLYPH_SLOTS] = {
+ GLYPH_XFER(0), GLYPH_XFER(1), GLYPH_XFER(2), GLYPH_XFER(3),
+ GLYPH_XFER(4), GLYPH_XFER(5), GLYPH_XFER(6), GLYPH_XFER(7) };
+// Slots shown by the LCD or by the text of any page (codes 0-15), and
+// slots handed out whose upload is still waiting
+static uint32_t GlyphsInUse (void) {
+ uint32_t used = 0;
+ for (int i = 0; i < GLYPH_SLOTS; i++)
+ if (updateGlyph[i] || glyphSending[i])
+ used |= 1 << i;
+ for (int j = 0; j < ROWS; j++)
+ for (int k = 0; k < LINE_COLS; k++) {
+ if (lcdText[j][k] < 16)
+ used |= 1 << (lcdText[j][k] & 7);
+ for (int p = 0; p < PAGES; p++)
+ if (dispText[p][j][k] < 16)
+ used |= 1 << (dispText[p][j][k] & 7);
+ }
+ return used;
+}
+// Obtain the character code showing a glyph, loading it on a miss.
+// A slot still in use is never replaced; when all are, GLYPH_NONE is
+// returned instead.
+uint8_t DisplayGlyph (const Glyph_t *glyph) {
+ for (int i = 0; i < GLYPH_SLOTS; i++)
+ if (glyphSlot[i] == glyph) {
+ glyphUsed[i] = ++glyphClock; // Hit
+ return 8 + i;
+ }
+ // Miss, replace the least recently used slot not in use
+ uint32_t used = GlyphsInUse();
+ int slot = -1;
+ for (int i = 0; i < GLYPH_SLOTS; i++)
+ if (!(used & 1 << i) && (slot == -1 || glyphUsed[i] < glyphUsed[slot]))
+ slot = i;
+ if (slot == -1)
+ return GLYPH_NONE;
+ glyphSlot[slot] = glyph;
+ glyphUsed[slot] = ++glyphClock;
+ updateGlyph[slot] = true;
+ return 8 + slot;
+}
+// Upload glyphs waiting for their slot, returns the bytes put on the bus
+static int UpdateGlyphs (int budget) {
+ int bytes = 0;
+ for (int i = 0; i < GLYPH_SLOTS; i++)
+ if (updateGlyph[i] && !glyphSending[i] && bytes + GLYPH_BYTES <= budget) {
+ updateGlyph[i] = false;
+ glyphSegs[i][1].data = (uint8_t *)glyphSlot[i]->rows;
+ glyphSending[i] = true;
+ I2C_Request(&DispGlyph[i]);
+ bytes += GLYPH_BYTES;
+ }
+ return bytes;
+}
+// Enable LCD display
+void DisplayEnable (void) {
+ if (!enabled) {
+ enabled = true;
+ I2C_Enable(LeafyI2C);
+ initSending = true;
+ I2C_Request(&DispInit);
+ // Blank out display text on all pages/rows
+ for (int i = 0; i < PAGES ; i++)
+ for (int j = 0; j < ROWS; j++)
+ for (int k = 0; k < LINE_COLS ; k++)
+ dispText[i][j][k] = ' ';
+ // Display Clear leaves the LCD blank
+ for (int j = 0; j < ROWS; j++)
+ for (int k = 0; k < LINE_COLS; k++)
+ lcdText[j][k] = ' ';
+ // Use the Touch En button to cycle between display pages
+ GPIO_Enable(TouchEn);
+ GPIO_Mode(TouchEn, INPUT);
+ GPIO_Callback(TouchEn, CallbackTouchEnEdge, RISE);
+ GPIO_Callback(TouchEn, CallbackTouchEnEdge, FALL);
+ }
+}
+// Convert a number to digits, written backwards so the last one lands just
+// before end. Returns the first digit.
+static char *Digits (char *end, unsigned int val, unsigned int base, char hex) {
+ do {
+ unsigned int d = val % base;
+ *--end = d < 10 ? '0' + d : hex + d - 10;
+ val /= base;
+ } while (val != 0);
+ return end;
+}
+// Format text into a line buffer, truncating at max characters.
+// Supports %d %i %u %x %X %c %s %% with optional '-' or '0' flag,
+// field width and 'l' modifier; no heap, no floating point.
+static int FormatText (uint8_t *buf, int max, const char *fmt, va_list args) {
+ int n = 0;
+ while (*fmt != '\0' && n < max) {
+ if (*fmt != '%') {
+ buf[n++] = *fmt++;
+ continue;
+ }
+ fmt++;
+ bool left = false, zero = false, neg = false;
+ for (; *fmt == '-' || *fmt == '0'; fmt++)
+ if (*fmt == '-')
+ left = true;
+ else
+ zero = true;
+ int width = 0;
+ for (; *fmt >= '0' && *fmt <= '9'; fmt++)
+ width = width * 10 + *fmt - '0';
+ while (*fmt == 'l')
+ fmt++; // int and long are the same size
+ // Convert argument into digits/characters
+ char num[11];
+ char *end = &num[sizeof(num)];
+ const char *str = num;
+ int len = 0;
+ switch (*fmt) {
+ case 'd': case 'i': {
+ int arg = va_arg(args, int);
+ neg = arg < 0;
+ str = Digits(end, neg ? -(unsigned int)arg : (unsigned int)arg, 10, 'a');
+ len = end - str;
+ break;
+ }
+ case 'u': case 'x': case 'X':
+ str = Digits(end, va_arg(args, unsigned int), *fmt == 'u' ? 10 : 16, *fmt == 'X' ? 'A' : 'a');
+ len = end - str;
+ break;
+ case 'c':
+ num[len++] = va_arg(args, int);
+ break;
+ case 's':
+ str = va_arg(args, const char *);
+ while (str[len] != '\0')
+ len++;
+ break;
+ case '%':
+ num[len++] = '%';
+ break;
+ default:
+ return n; // Unsupported conversion, stop here
+ }
+ fmt++;
+ // Pad to field width, sign goes before zero padding
+ int pad = width - len - neg;
+ if (neg && zero && n < max)
+ buf[n++] = '-';
+ for (; !left && pad > 0 && n < max; pad--)
+ buf[n++] = zero ? '0' : ' ';
+ if (neg && !zero && n < max)
+ buf[n++] = '-';
+ for (int i = 0; i < len && n < max; i++)
+ buf[n++] = str[i];
+ for (; pad > 0 && n < max; pad--)
+ buf[n++] = ' ';
+ }
+ return n;
+}
+// Print a line of text with optional format specifiers.
+// Text is cut at COLS characters, or LINE_COLS on a scrolling page.
+void DisplayPrint (Page_t page, const int line, const char *msg, ...) {
+ va_list args;
+ va_start(args, msg);
+ // Full buffer with formatted text and space pad the remainder
+ int chars = FormatText(dispText[page][line], dispScroll[page] ? LINE_COLS : COLS, msg, args);
+ va_end(args);
+ for (int i = chars; i < LINE_COLS; i++)
+ dispText[page][line][i] = ' ';
+ if (page == openPage)
+ updateLine[line] = true;
+}
+// Scroll a page one column every step ms, marquee style, 0 to stop.
+// The LCD shifts both rows together, so the whole page scrolls.
+void DisplayScroll (const Page_t page, const uint16_t step) {
+ if (dispScroll[page] == step)
+ return;
+ if (step == 0)
+ // Blank the text beyond the window
+ for (int j = 0; j < ROWS; j++) {
+ for (int k = COLS; k < LINE_COLS; k++)
+ dispText[page][j][k] = ' ';
+ if (page == openPage)
+ updateLine[j] = true;
+ }
+ dispScroll[page] = step;
+ if (page == openPage)
+ scrollTime = TimeNow();
+}
+// --------------------------------------------------------
+// Backlight controller
+// --------------------------------------------------------
+Color_t dispColor[PAGES] = {OFF, CYAN, MAGENTA, ORANGE};
+static uint16_t dispBlink[PAGES]; // Blink period in ms, 0 for steady color
+typedef struct {
+ uint8_t addr; // Address byte
+ uint8_t data; // Data byte
+} BltCmd_t;
+// Transmit data buffers to set brightness of each LED, all off by default
+static BltCmd_t txRed = {0x01, 0x00};
+static BltCmd_t txGreen = {0x02, 0x00};
+static BltCmd_t txBlue = {0x03, 0x00};
+static bool updateBlt = true;
+static Color_t bltColor; // Color last sent to the backlight
+static bool bltValid = false; // Backlight has been written since reset
+static bool blinkOff = false; // Blink currently in its dark half
+static Time_t blinkTime; // Time the current blink phase started
+// I2C transfers, one register each: the controller has only the three
+// channel registers, no auto-increment and no blink or group PWM registers,
+// so blinking is timed here
+#define BLT_XFER(tx) {.bus = &LeafyI2C, .addr = 0x5A, .data = (uint8_t *)&tx, \
+ .size = sizeof(tx), .stop = true, .prio = PRIO_BACKLIGHT, .latest = true, .keySize = 1}
+static I2C_Xfer_t BltRed = BLT_XFER(txRed);
+static I2C_Xfer_t BltGreen = BLT_XFER(txGreen);
+static I2C_Xfer_t BltBlue = BLT_XFER(txBlue);
+// Set new backlight color
+void DisplayColor(const Page_t page, const Color_t color) {
+ dispColor[page] = color;
+ dispBlink[page] = 0;
+ if (page == openPage)
+ updateBlt = true;
+}
+// Blink the backlight, alternating color and off every period/2 ms.
+// Calling again with the same settings keeps the blink running.
+void DisplayBlink(const Page_t page, const Color_t color, const uint16_t period) {
+ if (dispColor[page] == color && dispBlink[page] == period)
+ return;
+ dispColor[page] = color;
+ dispBlink[page] = period;
+ if (page == openPage) {
+ blinkOff = false;
+ blinkTime = TimeNow();
+ updateBlt = true;
+ }
+}
+// --------------------------------------------------------
+// Automatic background updates
+// --------------------------------------------------------
+// Compose a line of the open page into the LCD shadow and send the run
+// of characters that changed. A single run from the first to the last
+// change is sent: the header needed to restart at another column costs
+// about as much as the gap. A run longer than the byte budget is cut
+// short and the line stays pending for the next frame.
+// Returns the number of bytes put on the bus.
+static int UpdateLine (int j, int budget) {
+ uint8_t *text = dispText[openPage][j];
+ int first = 0, last = LINE_COLS - 1;
+ updateLine[j] = false;
+ while (first < LINE_COLS && text[first] == lcdText[j][first])
+ first++;
+ if (first == LINE_COLS)
+ return 0; // Unchanged, nothing to send
+ while (text[last] == lcdText[j][last])
+ last--;
+ int max = budget - LINE_BYTES;
+ if (max <= 0) {
+ updateLine[j] = true;
+ return 0; // No room left in this frame
+ }
+ if (last - first + 1 > max) {
+ last = first + max - 1;
+ updateLine[j] = true;
+ }
+ for (int k = first; k <= last; k++)
+ lcdText[j][k] = text[k];
+ // Point the DDRAM address at the first changed column
+ txLine[j].cmd.data = (j == 0 ? 0x80 : 0xC0) + first;
+ lineSegs[j][1].data = &lcdText[j][first];
+ lineSegs[j][1].size = last - first + 1;
+ lineSending[j] = true;
+ I2C_Request(&DispLine[j]);
+ return LINE_BYTES + last - first + 1;
+}
+// Frame counters
+void DisplayFrames (uint32_t *total, uint32_t *dropped) {
+ *total = frames;
+ *dropped = framesDropped;
+}
+// Work for UpdateDisplay: changes to send, a blinking or scrolling page,
+// a scroll to undo, or the Touch En button to debounce
+bool DisplayReady (void) {
+ for (int j = 0; j < ROWS; j++)
+ if (updateLine[j])
+ return true;
+ for (int i = 0; i < GLYPH_SLOTS; i++)
+ if (updateGlyph[i])
+ return true;
+ return touchEnEdge || updateBlt || rehome || lcdShift != 0
+ || dispBlink[openPage] != 0 || dispScroll[openPage] != 0;
+}
+// Called from main loop every DISPLAY_FRAME_MS, flushes pending changes
+void UpdateDisplay(void) {
+ // Every edge of the Touch En button restarts the debounce timer
+ if (touchEnEdge) {
+ touchEnEdge = false;
+ TimerStart(&touchEnTimer, DEBOUNCE_TIME, 0, CallbackTouchEnSettled);
+ }
+ frames++;
+ int budget = FRAME_BYTES;
+ bool late = false;
+ // Blink the backlight of the open page
+ uint16_t period = dispBlink[openPage];
+ if (period != 0 && TimePassed(blinkTime) >= period / 2) {
+ blinkTime += period / 2; // Phases stay period/2 apart, not frame multiples
+ blinkOff = !blinkOff;
+ updateBlt = true;
+ }
+ // Update backlight, only the channels that changed.
+ // Backlight writes are "latest value wins", so a request made while
+ // the previous one is still queued replaces it instead of piling up
+ if (updateBlt) {
+ updateBlt = false;
+ Color_t color = period != 0 && blinkOff ? OFF : dispColor[openPage];
+ uint32_t changed = bltValid ? color ^ bltColor : 0xFFFFFF;
+ bltColor = color;
+ bltValid = true;
+ // Extract individual color bytes
+ txRed .data = (color >> 16) & 0xFF;
+ txGreen.data = (color >> 8) & 0xFF;
+ txBlue .data = (color >> 0) & 0xFF;
+ if (changed & 0xFF0000) {
+ I2C_Request(&BltRed);
+ budget -= BLT_BYTES;
+ }
+ if (changed & 0x00FF00) {
+ I2C_Request(&BltGreen);
+ budget -= BLT_BYTES;
+ }
+ if (changed & 0x0000FF) {
+ I2C_Request(&BltBlue);
+ budget -= BLT_BYTES;
+ }
+ }
+ // Nothing reaches the LCD while a Clear or Return Home executes
+ if (initSending || homeSending || TimePassed(clearTime) < CLEAR_MS) {
+ for (int j = 0; j < ROWS; j++)
+ late |= updateLine[j];
+ if (late)
+ framesDropped++;
+ return;
+ }
+ // Glyphs go before the text that shows them
+ budget -= UpdateGlyphs(budget);
+ // Scroll the open page: restart at the first column after a page
+ // switch or when scrolling stopped, then one shift command per step
+ uint16_t step = dispScroll[openPage];
+ if (rehome || (step == 0 && lcdShift != 0)) {
+ if (!homeSending) {
+ rehome = false;
+ if (lcdShift != 0) {
+ lcdShift = 0;
+ homeSending = true;
+ I2C_Request(&DispHome);
+ budget = 0; // Text follows once the LCD is done
+ }
+ scrollTime = TimeNow();
+ }
+ }
+ else if (step != 0 && TimePassed(scrollTime) >= step && !shiftSending) {
+ // Steps stay step ms apart, not frame multiples; after a stall the
+ // missed steps are skipped rather than sent in a burst
+ scrollTime += step;
+ if (TimePassed(scrollTime) >= step)
+ scrollTime = TimeNow();
+ lcdShift = (lcdShift + 1) % LINE_COLS;
+ shiftSending = true;
+ I2C_Request(&DispShift);
+ budget -= CMD_BYTES;
+ }
+ // Update display text, once the previous write of a line has gone out
+ for (int j = 0; j < ROWS; j++)
+ if (updateLine[j]) {
+ if (!lineSending[j])
+ budget -= UpdateLine(j, budget);
+ late |= updateLine[j];
+ }
+ // Frame could not be shown completely, the rest follows in the next one
+ if (late)
+ framesDropped++;
+}
+// Called by the I2C driver when a display transfer is over, the next
+// one of its kind may be queued from the following frame on
+static void CallbackLineDone (I2C_Xfer_t *p) {
+ lineSending[p - DispLine] = false;
+}
+static void CallbackGlyphDone (I2C_Xfer_t *p) {
+ glyphSending[p - DispGlyph] = false;
+}
+static void CallbackInitDone (I2C_Xfer_t *p) {
+ (void)p;
+ clearTime = TimeNow();
+ initSending = false;
+}
+static void CallbackHomeDone (I2C_Xfer_t *p) {
+ (void)p;
+ clearTime = TimeNow();
+ homeSending = false;
+}
+static void CallbackShiftDone (I2C_Xfer_t *p) {
+ (void)p;
+ shiftSending = false;
+}
+// --------------------------------------------------------
+// Page switching
+// --------------------------------------------------------
+// Obtain the currently displayed page
+Page_t GetPage (void) {
+ return openPage;
+}
+static void CallbackTouchEnEdge (void) {
+ touchEnEdge = true;
+}
+// No edge for DEBOUNCE_TIME: take the button level, a release after a
+// settled press switches pages
+static void CallbackTouchEnSettled (Timer_t *t) {
+ (void)t;
+ bool down = GPIO_Input(TouchEn) == HIGH;
+ bool released = touchEnDown && !down;
+ touchEnDown = down;
+ if (released) {
+ // Switch to next page
+ openPage++;
+ openPage %= PAGES;
+ // Compose the new page against the LCD shadow, only the
+ // characters and backlight color that differ are sent
+ for (int i = 0; i < ROWS; i++)
+ updateLine[i] = true;
+ rehome = true;
+ blinkOff = false;
+ blinkTime = TimeNow();
+ updateBlt = true;
+ }
+}
@@ -0,0 +1,46 @@
+/*
+ * display.h
+ *
+ *  Created on: Oct 20, 2025
+ *      Author: bguer053
+ */
+
+#ifndef DISPLAY_H_
+#define DISPLAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum { ALARM = 0, CALC = 1} Page_t;
+#define PAGES 4
+
+typedef enum { RED=0xFF00000, GREEN=0x00FF00, BLUE=0x0000FF, YELLOW=0xFFFF00,
+	ORANGE=0xFFA500, CYAN=0x00FFFF, MAGENTA=0xFF00FF, WHITE=0xFFFFFF, OFF=0x000000
+} Color_t;
+
+// Custom 5x8 character, one row per byte, bit 4 leftmost
+typedef struct {
+	uint8_t rows[8];
+} Glyph_t;
+
+void DisplayEnable(void);
+void DisplayPrint(const Page_t page, const int line, const char *msg, ...)
+	__attribute__((format(printf, 3, 4)));
+void DisplayScroll(const Page_t page, const uint16_t step);
+void DisplayColor(const Page_t, const Color_t color);
+uint8_t DisplayGlyph(const Glyph_t *glyph);
+#define GLYPH_NONE 0xFF // Solid block, shown when every glyph slot is in use
+void DisplayBlink(const Page_t page, const Color_t color, const uint16_t period);
+
+// UpdateDisplay sends one frame per call and does not limit its own rate:
+// the caller runs it every DISPLAY_FRAME_MS (the scheduler task in main.c).
+// Each frame is limited to a byte budget, a frame that could not be sent in
+// full is counted as dropped and the rest follows in the next one.
+#define DISPLAY_FRAME_MS 33 // Display refresh period, about 30 Hz
+
+void UpdateDisplay(void);
+bool DisplayReady(void);
+void DisplayFrames(uint32_t *total, uint32_t *dropped);
+Page_t GetPage(void);
+
+#endif /* DISPLAY_H_ */
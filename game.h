@@ -0,0 +1,19 @@
+/*
+ * game.h
+ *
+ *  Created on: Oct 20, 2025
+ *      Author: bguer053
+ */
+
+#ifndef GAME_H_
+#define GAME_H_
+
+#include <stdbool.h>
+
+void Init_Game();
+void Task_Game();
+bool Ready_Game(void);
+
+
+
+#endif /* GAME_H_ */
@@ -1,93 +1,676 @@
-/*
- * i2c.c
- *
- *  Created on: Oct 6, 2025
- *      Author: bguer053
- */
-
-// I2C driver version 3
-#include <stddef.h>
-#include <stdio.h>
-#include "i2c.h"
-#include "gpio.h"
-// There is one I2C bus present on the lab platform:
-I2C_Bus_t LeafyI2C = {
- I2C2, // I2C controller 2
- {GPIOF, 0}, // SDA pin PF0
- {GPIOF, 1} // SCL pin PF1
-};
-// Pointers to head and tail of the transfer queue
-static I2C_Xfer_t *head = NULL;
-static I2C_Xfer_t *tail = NULL;
-static int n = -1; // Number of bytes transferred, -1 when idle
-// Bit 0 of address byte indicates read vs write transfer
-#define I2C_READ (head->addr & 0x1)
-#define I2C_WRITE (!(head->addr & 0x1))
-// Enable I2C controller and configure associated GPIO pins
-void I2C_Enable (I2C_Bus_t bus) {
- if (bus.iface->CR1 & I2C_CR1_PE)
- return; // Already enabled
- // Enable clock to selected I2C controller
- RCC->APB1ENR1 |= bus.iface == I2C1 ? RCC_APB1ENR1_I2C1EN :
- bus.iface == I2C2 ? RCC_APB1ENR1_I2C2EN :
- bus.iface == I2C3 ? RCC_APB1ENR1_I2C3EN :
- bus.iface == I2C4 ? RCC_APB1ENR2_I2C4EN : 0;
- // Enable clocks to GPIO ports containing SDA and SCL pins
- GPIO_Enable(bus.pinSDA);
- GPIO_Enable(bus.pinSCL);
- // Configure for open drain (PMOS disabled)
- GPIO_Config(bus.pinSDA, OD, S0, NOPUPD);
- GPIO_Config(bus.pinSCL, OD, S0, NOPUPD);
- // Select alternate function as I2C
- GPIO_AltFunc(bus.pinSDA, 0x4);
- GPIO_AltFunc(bus.pinSCL, 0x4);
- // Alternate function mode
- GPIO_Mode(bus.pinSDA, ALTFUNC);
- GPIO_Mode(bus.pinSCL, ALTFUNC);
- // Configure I2C peripheral
- bus.iface->CR1 &= ~I2C_CR1_PE;
- bus.iface->TIMINGR = 0xE14;
- bus.iface->CR1 = I2C_CR1_PE;
-}
-// Add a transfer request to the queue
-void I2C_Request (I2C_Xfer_t *p) {
- if (head == NULL)
- head = p; // Add to empty queue
- else
- tail->next = p; // Add to tail of non-empty queue
- tail = p;
- p->next = NULL;
- p->busy = true; // Mark transfer as in-progress
-}
-// Polling implementation, called from main loop every tick
-void ServiceI2CRequests (void) {
- if (head == NULL)
- return; // Nothing to do right now
- I2C_Xfer_t *q = head;
- I2C_TypeDef *i2c = q->bus->iface;
- if (n == -1) {
- // Begin a new transfer
- n = 0;
- i2c->ICR = 0xFFFF; // Clear flags
- i2c->CR2 = (q->addr & 0xFE)
- | I2C_READ << I2C_CR2_RD_WRN_Pos
-| q->size << I2C_CR2_NBYTES_Pos
- | q->stop << I2C_CR2_AUTOEND_Pos
- | I2C_CR2_START;
- }
- else if (n < q->size) {
- if (i2c->ISR & I2C_ISR_TXIS)
- // Copy transmit data from memory buffer to hardware buffer
- i2c->TXDR = q->data[n++];
- if (i2c->ISR & I2C_ISR_RXNE)
- // Copy receive data from hardware buffer to memory buffer
- q->data[n++] = i2c->RXDR;
- }
- else {
- // Remove transfer from head of queue
- head = q->next;
- q->next = NULL;
- q->busy = 0; // Mark transfer as complete
- n = -1; // Prepare for next transfer
- }
-}
+/*
+ * i2c.c
+ *
+ *  Created on: Oct 6, 2025
+ *      Author: bguer053
+ */
+
+// I2C driver version 4
+// Transfers are driven from the I2C event/error interrupts so the queue drains
+// at bus speed. Build with I2C_POLLED defined to service it from the main loop.
+// Transfers of I2C_DMA_MIN bytes or more are moved by DMA (disable with I2C_NO_DMA).
+// Failed or stuck transfers are retired with a status code and the bus is cleared
+// from the main loop.
+// TIMINGR is computed from the kernel clock and the requested bus rate.
+// Each controller has its own queue and state machine, so buses run concurrently.
+// Per-device usage and latency statistics are kept for sizing refresh/poll rates.
+// "Latest value wins" writes are coalesced instead of queuing stale copies.
+// A transfer may gather its data from several buffers (scatter-gather segments).
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "i2c.h"
+#include "gpio.h"
+#include "systick.h"
+#include "profile.h"
+// There is one I2C bus present on the lab platform:
+I2C_Bus_t LeafyI2C = {
+ I2C2, // I2C controller 2
+ {GPIOF, 0}, // SDA pin PF0
+ {GPIOF, 1} // SCL pin PF1
+};
+// Transfer queue and state machine of one I2C controller
+typedef struct {
+ I2C_TypeDef *iface; // Controller registers
+ I2C_Xfer_t *head[I2C_PRIOS]; // Head of the queue for each priority class
+ I2C_Xfer_t *tail[I2C_PRIOS]; // Tail of the queue for each priority class
+ I2C_Xfer_t *cur; // Transfer in progress
+ int held; // Class that left the bus held without STOP, -1 if none
+ I2C_Seg_t one; // Segment for a phase with a single buffer
+ const I2C_Seg_t *seg; // Current segment of this phase
+ int n; // Number of bytes transferred from current segment
+ int left; // Number of bytes left in this phase
+ bool rd; // Phase reads from the target
+ bool dma; // Phase data moved by DMA
+ bool regPhase; // Writing the register address of a combined transfer
+ Time_t since; // Start of current transfer, or of bus hold
+ uint32_t start; // Cycle count at START of current transfer
+ uint32_t rate; // Bus rate (Hz)
+ uint32_t timing; // TIMINGR for rate at the kernel clock, computed outside interrupts
+ bool retime; // Timing change waiting for the bus to go idle
+ bool repeat; // Transfer in progress was requested again with newer data
+ I2C_Bus_t *stuck; // Bus waiting to be cleared from the main loop, NULL if none
+} I2C_State_t;
+#define I2C_STATE(iface) {iface, {NULL}, {NULL}, NULL, -1, {NULL, 0}, NULL, 0, 0, false, false, \
+ false, 0, 0, 100000, 0, false, false, NULL}
+static I2C_State_t state[4] = {
+ I2C_STATE(I2C1), I2C_STATE(I2C2), I2C_STATE(I2C3), I2C_STATE(I2C4) };
+static uint32_t clockHz = 4000000; // I2C kernel clock (PCLK1, MSI 4 MHz after reset)
+static I2C_Stats_t stats[I2C_STATS_DEVICES]; // Per-device statistics, addr 0 when free
+// Bit 0 of address byte indicates read vs write transfer
+#define I2C_READ(q) ((q)->addr & 0x1)
+#define I2C_WRITE(q) (!((q)->addr & 0x1))
+// Interrupt sources used by the transfer state machine
+#define I2C_IRQ_ENABLES (I2C_CR1_TXIE | I2C_CR1_RXIE | I2C_CR1_TCIE \
+ | I2C_CR1_STOPIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE)
+#define I2C_IRQ_PRIORITY 1 // Below GPIO callbacks (0), above SysTick (7)
+#ifdef I2C_POLLED
+#define I2C_TIMEOUT_MS 50 // ms, a polled transfer moves one byte per tick
+#else
+#define I2C_TIMEOUT_MS 5 // ms, several times the longest transfer at 100 kHz
+#endif
+#if !defined(I2C_POLLED) && !defined(I2C_NO_DMA)
+#define I2C_DMA
+#define I2C_DMA_MIN 8 // Smallest transfer worth setting up DMA for (DispInit, DispLine)
+// One DMA channel per controller, DMAMUX channel x feeds DMA1 channel x+1
+static DMA_Channel_TypeDef *const dmaCh[4] = {
+ DMA1_Channel1, DMA1_Channel2, DMA1_Channel3, DMA1_Channel4 };
+static DMAMUX_Channel_TypeDef *const muxCh[4] = {
+ DMAMUX1_Channel0, DMAMUX1_Channel1, DMAMUX1_Channel2, DMAMUX1_Channel3 };
+// DMAMUX1 request inputs (RM0438 DMAMUX1 assignment table)
+#define DMAREQ_I2C1_RX 17
+#define DMAREQ_I2C2_RX 19
+#define DMAREQ_I2C3_RX 21
+#define DMAREQ_I2C4_RX 23 // TX request is always RX + 1
+#endif
+static void StartNext(I2C_State_t *s);
+#ifndef I2C_POLLED
+// Enable an interrupt vector at the I2C priority level
+static void EnableIRQ (IRQn_Type irq) {
+ NVIC->IPR[irq] = I2C_IRQ_PRIORITY << (8 - __NVIC_PRIO_BITS);
+ __COMPILER_BARRIER();
+ NVIC->ISER[irq / 32] = 1 << (irq % 32);
+ __COMPILER_BARRIER();
+}
+#endif
+// Bus timing characteristics from the I2C specification, in picoseconds
+typedef struct {
+ uint32_t rate; // Highest bus rate of this mode (Hz)
+ uint32_t tLow; // Minimum SCL low period
+ uint32_t tHigh; // Minimum SCL high period
+ uint32_t tRise; // Maximum rise time
+ uint32_t tFall; // Maximum fall time
+ uint32_t tSuDat; // Minimum data setup time
+ uint32_t tHdDat; // Maximum data hold time
+} I2C_Mode_t;
+static const I2C_Mode_t modes[] = {
+ { 100000, 4700000, 4000000, 1000000, 300000, 250000, 3450000}, // Standard
+ { 400000, 1300000, 600000, 300000, 300000, 100000, 900000}, // Fast
+ {1000000, 500000, 260000, 120000, 120000, 50000, 450000} // Fast-mode Plus
+};
+#define T_AF_MIN 50000 // Analog filter delay range (filter on, DNF = 0)
+#define T_AF_MAX 260000
+// Compute TIMINGR for the requested bus rate, following the reference manual
+// formulas for SCLDEL/SDADEL and splitting the SCL period between SCLL/SCLH.
+// Rates the kernel clock cannot reach are stretched to the nearest legal timing.
+uint32_t I2C_Timing (uint32_t kernelHz, uint32_t rate) {
+ const I2C_Mode_t *m = &modes[0];
+ while (m->rate < rate && m < &modes[2])
+ m++;
+ if (rate > m->rate)
+ rate = m->rate;
+ uint32_t tClk = 1000000000000ULL / kernelHz;
+ uint32_t tSync = 2 * T_AF_MIN + 4 * tClk; // SCL input filter and synchronization
+ uint32_t tScl = 1000000000000ULL / rate;
+ int presc, scldel = 0, sdadel = 0, low = 256, high = 256;
+ for (presc = 0; presc < 16; presc++) {
+ uint32_t tPresc = (presc + 1) * tClk;
+ // Data setup: tSCLDEL >= tr + tSU;DAT
+ scldel = (m->tRise + m->tSuDat + tPresc - 1) / tPresc - 1;
+ // Data hold: tf - tAF(min) - 3 tI2CCLK <= tSDADEL <= tHD;DAT(max) - tAF(max) - 4 tI2CCLK
+ int32_t hdMin = (int32_t)m->tFall - T_AF_MIN - 3 * (int32_t)tClk;
+ sdadel = hdMin > 0 ? (hdMin + tPresc - 1) / tPresc : 0;
+ int32_t hdMax = (int32_t)m->tHdDat - T_AF_MAX - 4 * (int32_t)tClk;
+ // SCL low/high counts, minimums first, then the rest of the period
+ low = (m->tLow + tPresc - 1) / tPresc;
+ high = (m->tHigh + tPresc - 1) / tPresc;
+ int extra = tScl > tSync ? (int)((tScl - tSync) / tPresc) - low - high : 0;
+ if (extra > 0) {
+ low += (extra + 1) / 2;
+ high += extra / 2;
+ }
+ // (a slow kernel clock may miss the hold window even with SDADEL = 0)
+ if (scldel <= 15 && sdadel <= 15 && (sdadel == 0 || sdadel * (int32_t)tPresc <= hdMax)
+ && low <= 256 && high <= 256)
+ break; // Finest prescaler that fits
+ }
+ if (presc == 16)
+ presc = 15; // Kernel clock too fast for this rate, use the slowest timing
+ if (scldel < 0) scldel = 0;
+ if (scldel > 15) scldel = 15;
+ if (sdadel > 15) sdadel = 15;
+ if (low > 256) low = 256;
+ if (high > 256) high = 256;
+ return presc << I2C_TIMINGR_PRESC_Pos
+ | scldel << I2C_TIMINGR_SCLDEL_Pos
+ | sdadel << I2C_TIMINGR_SDADEL_Pos
+ | (high - 1) << I2C_TIMINGR_SCLH_Pos
+ | (low - 1) << I2C_TIMINGR_SCLL_Pos;
+}
+// Index of I2C controller
+static int BusIndex (I2C_TypeDef *i2c) {
+ return i2c == I2C1 ? 0 : i2c == I2C2 ? 1 : i2c == I2C3 ? 2 : 3;
+}
+// Program TIMINGR of a controller, which may only be written while disabled;
+// the value was worked out beforehand, this runs from the interrupt path
+static void ApplyTiming (I2C_State_t *s) {
+ I2C_TypeDef *i2c = s->iface;
+ int i = s - state;
+ uint32_t cr1 = i2c->CR1;
+ s->retime = false;
+ i2c->CR1 = cr1 & ~I2C_CR1_PE;
+ i2c->TIMINGR = s->timing;
+ // Fast-mode Plus needs the stronger output drivers
+ RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+ uint32_t fmp = i == 0 ? SYSCFG_CFGR1_I2C1_FMP : i == 1 ? SYSCFG_CFGR1_I2C2_FMP :
+ i == 2 ? SYSCFG_CFGR1_I2C3_FMP : SYSCFG_CFGR1_I2C4_FMP;
+ if (s->rate > 400000)
+ SYSCFG->CFGR1 |= fmp;
+ else
+ SYSCFG->CFGR1 &= ~fmp;
+ i2c->CR1 = cr1;
+}
+// Half an SCL period for the bit-banged bus clear (~5us at 4 MHz)
+static void BitDelay (void) {
+ for (volatile int i = 0; i < 3; i++)
+ ;
+}
+// Reset the controller and free a bus held low by a confused target:
+// clock SCL until SDA is released, then issue a STOP condition.
+// Toggles the pins for tens of us, so it runs from the main loop with
+// interrupts enabled.
+static void ClearBus (I2C_Bus_t *bus) {
+ I2C_TypeDef *i2c = bus->iface;
+ uint32_t cr1 = i2c->CR1;
+ i2c->CR1 = cr1 & ~I2C_CR1_PE; // Software reset of the controller
+ GPIO_Output(bus->pinSCL, HIGH);
+ GPIO_Output(bus->pinSDA, HIGH);
+ GPIO_Mode(bus->pinSCL, OUTPUT);
+ GPIO_Mode(bus->pinSDA, OUTPUT);
+ for (int i = 0; i < 9 && GPIO_Input(bus->pinSDA) == LOW; i++) {
+ GPIO_Output(bus->pinSCL, LOW);
+ BitDelay();
+ GPIO_Output(bus->pinSCL, HIGH);
+ BitDelay();
+ }
+ // STOP: SDA rises while SCL is high
+ GPIO_Output(bus->pinSCL, LOW);
+ GPIO_Output(bus->pinSDA, LOW);
+ BitDelay();
+ GPIO_Output(bus->pinSCL, HIGH);
+ BitDelay();
+ GPIO_Output(bus->pinSDA, HIGH);
+ BitDelay();
+ // Hand the pins back to the controller
+ GPIO_Mode(bus->pinSCL, ALTFUNC);
+ GPIO_Mode(bus->pinSDA, ALTFUNC);
+ i2c->CR1 = cr1;
+}
+#ifdef I2C_DMA
+// Point the DMA channel at the next segment; the controller stretches the
+// clock while the channel is reloaded from the DMA interrupt
+static void LoadDMA (I2C_State_t *s) {
+ DMA_Channel_TypeDef *ch = dmaCh[s - state];
+ while (s->seg->size == 0)
+ s->seg++; // Skip empty segments
+ ch->CCR = 0; // Channel must be disabled to reprogram
+ ch->CM0AR = (uint32_t)s->seg->data;
+ ch->CNDTR = s->seg->size;
+ s->left -= s->seg->size;
+ s->seg++;
+ // Byte-wide, memory increment, memory-to-peripheral for writes,
+ // interrupt at the end of the segment if another one follows
+ ch->CCR = DMA_CCR_MINC | !s->rd << DMA_CCR_DIR_Pos
+ | (s->left > 0) << DMA_CCR_TCIE_Pos | DMA_CCR_EN;
+}
+// Point the DMA channel at the controller data register and the first segment
+static void StartDMA (I2C_State_t *s, bool rd) {
+ I2C_TypeDef *i2c = s->iface;
+ DMA_Channel_TypeDef *ch = dmaCh[s - state];
+ int req = i2c == I2C1 ? DMAREQ_I2C1_RX :
+ i2c == I2C2 ? DMAREQ_I2C2_RX :
+ i2c == I2C3 ? DMAREQ_I2C3_RX : DMAREQ_I2C4_RX;
+ ch->CCR = 0; // Channel must be disabled to reprogram
+ if (rd) {
+ muxCh[s - state]->CCR = req << DMAMUX_CxCR_DMAREQ_ID_Pos;
+ ch->CPAR = (uint32_t)&i2c->RXDR;
+ }
+ else {
+ muxCh[s - state]->CCR = (req + 1) << DMAMUX_CxCR_DMAREQ_ID_Pos;
+ ch->CPAR = (uint32_t)&i2c->TXDR;
+ }
+ LoadDMA(s);
+}
+// DMA segment finished, continue with the next one
+static void ServiceDMA (I2C_State_t *s) {
+ int i = s - state;
+ DMA1->IFCR = DMA_IFCR_CGIF1 << (4 * i);
+ if (s->cur != NULL && s->dma && s->left > 0)
+ LoadDMA(s);
+}
+void DMA1_Channel1_IRQHandler (void) { ServiceDMA(&state[0]); }
+void DMA1_Channel2_IRQHandler (void) { ServiceDMA(&state[1]); }
+void DMA1_Channel3_IRQHandler (void) { ServiceDMA(&state[2]); }
+void DMA1_Channel4_IRQHandler (void) { ServiceDMA(&state[3]); }
+#endif
+// Enable I2C controller and configure associated GPIO pins
+void I2C_Enable (I2C_Bus_t bus) {
+ if (bus.iface->CR1 & I2C_CR1_PE)
+ return; // Already enabled
+ // Enable clock to selected I2C controller
+ RCC->APB1ENR1 |= bus.iface == I2C1 ? RCC_APB1ENR1_I2C1EN :
+ bus.iface == I2C2 ? RCC_APB1ENR1_I2C2EN :
+ bus.iface == I2C3 ? RCC_APB1ENR1_I2C3EN :
+ bus.iface == I2C4 ? RCC_APB1ENR2_I2C4EN : 0;
+ // Enable clocks to GPIO ports containing SDA and SCL pins
+ GPIO_Enable(bus.pinSDA);
+ GPIO_Enable(bus.pinSCL);
+ // Configure for open drain (PMOS disabled)
+ GPIO_Config(bus.pinSDA, OD, S0, NOPUPD);
+ GPIO_Config(bus.pinSCL, OD, S0, NOPUPD);
+ // Select alternate function as I2C
+ GPIO_AltFunc(bus.pinSDA, 0x4);
+ GPIO_AltFunc(bus.pinSCL, 0x4);
+ // Alternate function mode
+ GPIO_Mode(bus.pinSDA, ALTFUNC);
+ GPIO_Mode(bus.pinSCL, ALTFUNC);
+ // Configure I2C peripheral
+ bus.iface->CR1 &= ~I2C_CR1_PE;
+ I2C_State_t *s = &state[BusIndex(bus.iface)];
+ s->timing = I2C_Timing(clockHz, s->rate);
+ ApplyTiming(s);
+ bus.iface->CR1 = I2C_CR1_PE;
+#ifndef I2C_POLLED
+ // Let the event and error interrupts drive the transfer queue
+ bus.iface->CR1 |= I2C_IRQ_ENABLES;
+ EnableIRQ(bus.iface == I2C1 ? I2C1_EV_IRQn :
+ bus.iface == I2C2 ? I2C2_EV_IRQn :
+ bus.iface == I2C3 ? I2C3_EV_IRQn : I2C4_EV_IRQn);
+ EnableIRQ(bus.iface == I2C1 ? I2C1_ER_IRQn :
+ bus.iface == I2C2 ? I2C2_ER_IRQn :
+ bus.iface == I2C3 ? I2C3_ER_IRQn : I2C4_ER_IRQn);
+#endif
+#ifdef I2C_DMA
+ RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN | RCC_AHB1ENR_DMAMUX1EN;
+ EnableIRQ(DMA1_Channel1_IRQn + BusIndex(bus.iface));
+#endif
+}
+// Select the bus rate (e.g. 100 kHz, 400 kHz or 1 MHz Fast-mode Plus)
+void I2C_SetSpeed (I2C_Bus_t bus, uint32_t rate) {
+ state[BusIndex(bus.iface)].rate = rate;
+ I2C_SetClock(clockHz);
+}
+// Report a new I2C kernel clock frequency, timings follow once each bus is idle
+void I2C_SetClock (uint32_t kernelHz) {
+ uint32_t timing[4];
+ for (int i = 0; i < 4; i++)
+ timing[i] = I2C_Timing(kernelHz, state[i].rate); // Slow, keep it out of the critical section
+ uint32_t primask = __get_PRIMASK();
+ __disable_irq();
+ clockHz = kernelHz;
+ for (I2C_State_t *s = state; s < &state[4]; s++)
+ if (s->iface->CR1 & I2C_CR1_PE) {
+ s->timing = timing[s - state];
+ s->retime = true;
+ if (s->cur == NULL && s->held == -1)
+ ApplyTiming(s);
+ }
+ __set_PRIMASK(primask);
+}
+// Total number of data bytes of a transfer (excluding register address)
+static int DataSize (I2C_Xfer_t *q) {
+ if (q->nSegs == 0)
+ return q->size;
+ int size = 0;
+ for (int i = 0; i < q->nSegs; i++)
+ size += q->segs[i].size;
+ return size;
+}
+// First data byte of a transfer
+static uint8_t *DataStart (I2C_Xfer_t *q) {
+ return q->nSegs == 0 ? q->data : q->segs[0].data;
+}
+// Account a finished transfer against its target device
+static void RecordStats (I2C_State_t *s, I2C_Xfer_t *q) {
+ uint8_t addr = q->addr >> 1;
+ I2C_Stats_t *st = stats;
+ while (st < &stats[I2C_STATS_DEVICES - 1] && st->addr != addr && st->addr != 0)
+ st++; // Find device slot or first free one
+ if (st == &stats[I2C_STATS_DEVICES - 1])
+ addr = I2C_STATS_OTHER; // Out of slots, counted with the other devices
+ st->addr = addr;
+ uint32_t service = ProfileCycles() - s->start;
+ Time_t latency = TimePassed(q->queued);
+ st->transfers++;
+ if (q->status == I2C_OK)
+ st->bytes += DataSize(q) + q->regSize;
+ else
+ st->errors++;
+ st->waitTime += (Time_t)(s->since - q->queued);
+ st->serviceCycles += service;
+ if (latency > st->maxLatency)
+ st->maxLatency = latency;
+}
+// Copy the statistics of all devices seen so far
+int I2C_GetStats (I2C_Stats_t *snap) {
+ int i;
+ uint32_t primask = __get_PRIMASK();
+ __disable_irq();
+ for (i = 0; i < I2C_STATS_DEVICES && stats[i].addr != 0; i++)
+ snap[i] = stats[i];
+ __set_PRIMASK(primask);
+ return i;
+}
+// Start a new measurement period
+void I2C_ResetStats (void) {
+ uint32_t primask = __get_PRIMASK();
+ __disable_irq();
+ for (int i = 0; i < I2C_STATS_DEVICES; i++)
+ stats[i] = (I2C_Stats_t){0};
+ __set_PRIMASK(primask);
+}
+// Append a transfer to the tail of its priority class
+static void Enqueue (I2C_State_t *s, I2C_Xfer_t *p) {
+ p->next = NULL;
+ if (s->head[p->prio] == NULL)
+ s->head[p->prio] = p; // Add to empty queue
+ else
+ s->tail[p->prio]->next = p; // Add to tail of non-empty queue
+ s->tail[p->prio] = p;
+}
+// Coalesce a "latest value wins" write with what is already queued.
+// Returns true if the request was absorbed and must not be appended.
+static bool Coalesce (I2C_State_t *s, I2C_Xfer_t *p) {
+ if (p == s->cur) {
+ s->repeat = true; // Send once more when the current copy finishes
+ return true;
+ }
+ if (p->busy)
+ return true; // Still queued, buffer is read when it starts
+ // Same device and register from another record: take over its place
+ for (I2C_Xfer_t **link = &s->head[p->prio]; *link != NULL; link = &(*link)->next) {
+ I2C_Xfer_t *q = *link;
+ if (!q->latest || q->addr != p->addr || q->keySize != p->keySize
+ || memcmp(DataStart(q), DataStart(p), p->keySize) != 0)
+ continue;
+ p->next = q->next;
+ *link = p;
+ if (s->tail[p->prio] == q)
+ s->tail[p->prio] = p;
+ q->next = NULL;
+ q->status = I2C_REPLACED;
+ q->busy = false;
+ if (q->done != NULL)
+ q->done(q);
+ return true;
+ }
+ return false;
+}
+// Add a transfer request to the queue of its bus and priority class
+void I2C_Request (I2C_Xfer_t *p) {
+ I2C_State_t *s = &state[BusIndex(p->bus->iface)];
+ // Keep the I2C interrupts out while the queue is modified
+ uint32_t primask = __get_PRIMASK();
+ __disable_irq();
+ bool absorbed = p->latest && I2C_WRITE(p) && Coalesce(s, p);
+ if (!p->busy || !absorbed) {
+ p->busy = true; // Mark transfer as in-progress
+ p->status = I2C_OK;
+ p->queued = TimeNow();
+ }
+ if (!absorbed)
+ Enqueue(s, p);
+ if (s->cur == NULL)
+ StartNext(s); // Bus is idle, begin right away
+ __set_PRIMASK(primask);
+}
+// Program the controller for one phase (START/repeated START) of the transfer
+static void StartPhase (I2C_State_t *s, bool rd, const I2C_Seg_t *seg, int size, bool stop) {
+ I2C_TypeDef *i2c = s->iface;
+ s->seg = seg;
+ s->n = 0;
+ s->left = size;
+ s->rd = rd;
+ s->dma = false;
+#ifdef I2C_DMA
+ if (size >= I2C_DMA_MIN) {
+ // DMA moves the data, interrupts only report the end of the transfer
+ s->dma = true;
+ StartDMA(s, rd);
+ i2c->CR1 = (i2c->CR1 & ~(I2C_CR1_TXIE | I2C_CR1_RXIE))
+ | (rd ? I2C_CR1_RXDMAEN : I2C_CR1_TXDMAEN);
+ }
+ else
+ i2c->CR1 = (i2c->CR1 & ~(I2C_CR1_TXDMAEN | I2C_CR1_RXDMAEN))
+ | I2C_CR1_TXIE | I2C_CR1_RXIE;
+#endif
+ i2c->CR2 = (s->cur->addr & 0xFE)
+ | rd << I2C_CR2_RD_WRN_Pos
+ | size << I2C_CR2_NBYTES_Pos
+ | stop << I2C_CR2_AUTOEND_Pos
+ | I2C_CR2_START;
+}
+// Program the data phase of the current transfer
+static void StartData (I2C_State_t *s) {
+ I2C_Xfer_t *q = s->cur;
+ if (q->nSegs == 0) {
+ s->one = (I2C_Seg_t){q->data, q->size};
+ StartPhase(s, I2C_READ(q), &s->one, q->size, q->stop);
+ }
+ else
+ StartPhase(s, I2C_READ(q), q->segs, DataSize(q), q->stop);
+}
+// Begin the current transfer
+static void StartTransfer (I2C_State_t *s) {
+ I2C_Xfer_t *q = s->cur;
+ I2C_TypeDef *i2c = s->iface;
+ s->since = TimeNow();
+ s->start = ProfileCycles();
+ i2c->ICR = 0xFFFF; // Clear flags
+#ifndef I2C_POLLED
+ i2c->CR1 |= I2C_CR1_TCIE; // Re-arm if the bus was left held after TC
+#endif
+ // Combined transfers write the register address first, without STOP
+ s->regPhase = q->regSize > 0;
+ if (s->regPhase) {
+ s->one = (I2C_Seg_t){q->reg, q->regSize};
+ StartPhase(s, false, &s->one, q->regSize, false);
+ }
+ else
+ StartData(s);
+}
+// Any transfer waiting in the queues of a controller
+static bool Waiting (I2C_State_t *s) {
+ for (int p = 0; p < I2C_PRIOS; p++)
+ if (s->head[p] != NULL)
+ return true;
+ return false;
+}
+// Dequeue and begin the highest priority waiting transfer. A transfer without
+// STOP keeps the bus for its own class so write/read pairs stay together,
+// but not while the other half is missing and another class is waiting.
+static void StartNext (I2C_State_t *s) {
+ if (s->stuck != NULL)
+ return; // Bus clear first, the main loop starts the queue again
+ int p = s->held;
+ if (p != -1 && s->head[p] == NULL && Waiting(s)) {
+ // Second half not requested, end the pair instead of starving the rest
+ s->held = -1;
+ s->iface->CR2 |= I2C_CR2_STOP;
+ }
+ if (s->retime && s->held == -1)
+ ApplyTiming(s); // Deferred clock or speed change
+ p = s->held;
+ if (p == -1)
+ for (p = I2C_PRIOS - 1; p > 0 && s->head[p] == NULL; p--)
+ ; // Find highest non-empty class
+ if (s->head[p] == NULL)
+ return; // Nothing waiting (or held class not requested yet)
+ s->cur = s->head[p];
+ s->head[p] = s->cur->next;
+ s->cur->next = NULL;
+ s->held = s->cur->stop ? -1 : p;
+ StartTransfer(s);
+}
+// Retire the finished transfer and start the next
+static void EndTransfer (I2C_State_t *s) {
+ I2C_Xfer_t *q = s->cur;
+ SysTickNotify(); // Completion callbacks hand work to the main loop
+#ifdef I2C_DMA
+ dmaCh[s - state]->CCR = 0; // Release the DMA channel
+#endif
+ RecordStats(s, q);
+ s->cur = NULL;
+ if (s->repeat) {
+ // Requested again while on the bus, send the newer data too
+ s->repeat = false;
+ q->status = I2C_OK; // The outcome of the newer copy counts
+ q->queued = TimeNow();
+ Enqueue(s, q);
+ }
+ else
+ q->busy = false; // Mark transfer as complete
+ s->since = TimeNow(); // Time any bus hold that follows
+ if (s->held != -1 && q->done != NULL) {
+ // First half of a pair, the client queues the second half from its
+ // callback before the bus may be offered to the other classes
+ q->done(q);
+ if (s->cur == NULL)
+ StartNext(s);
+ return;
+ }
+ StartNext(s);
+ // Notify the client last so it may queue a follow-up transfer
+ if (q->done != NULL)
+ q->done(q);
+}
+// Location of the next byte of this phase, moving on through the segments
+static uint8_t *NextByte (I2C_State_t *s) {
+ while (s->n == s->seg->size) {
+ s->seg++; // Current segment exhausted
+ s->n = 0;
+ }
+ s->left--;
+ return &s->seg->data[s->n++];
+}
+// Advance the transfer state machine from the controller's status flags
+static void ServiceTransfer (I2C_State_t *s) {
+ I2C_TypeDef *i2c = s->iface;
+ I2C_Xfer_t *q = s->cur;
+ uint32_t isr = i2c->ISR;
+ if (q == NULL) {
+ // Nothing in progress, discard stray flags; a bus held after a
+ // transfer without STOP keeps TC set until the next request
+ i2c->ICR = 0xFFFF;
+ i2c->CR1 &= ~I2C_CR1_TCIE;
+ return;
+ }
+ if (isr & I2C_ISR_NACKF) {
+ // Target did not acknowledge, controller follows up with STOP
+ i2c->ICR = I2C_ICR_NACKCF;
+ q->status = I2C_NACK;
+ }
+ if (isr & (I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR)) {
+ // Abandon the transfer, a misplaced START/STOP may leave the bus stuck
+ i2c->ICR = I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF;
+ q->status = isr & I2C_ISR_ARLO ? I2C_ARLO : I2C_BERR;
+ if (q->status == I2C_BERR)
+ s->stuck = q->bus; // Cleared from the main loop
+ s->held = -1;
+ EndTransfer(s);
+ return;
+ }
+ if ((isr & I2C_ISR_TXIS) && !s->dma && s->left > 0)
+ // Copy transmit data from memory buffer to hardware buffer
+ i2c->TXDR = *NextByte(s);
+ if ((isr & I2C_ISR_RXNE) && !s->dma && s->left > 0)
+ // Copy receive data from hardware buffer to memory buffer
+ *NextByte(s) = i2c->RXDR;
+ if (isr & I2C_ISR_STOPF) {
+ // STOP issued after last byte (or NACK), transfer is over; after a
+ // NACK the bus is released even if the transfer was to keep it
+ i2c->ICR = I2C_ICR_STOPCF;
+ s->held = -1;
+ EndTransfer(s);
+ }
+ else if ((isr & I2C_ISR_TC) && s->regPhase) {
+ // Register address sent, turn the bus around with a repeated START
+ s->regPhase = false;
+ StartData(s);
+ }
+ else if (isr & I2C_ISR_TC) {
+ // Last byte sent without STOP, next START becomes a repeated START
+ EndTransfer(s);
+ if (s->cur == NULL)
+ i2c->CR1 &= ~I2C_CR1_TCIE; // Hold the bus until the next request
+ }
+}
+#ifndef I2C_POLLED
+// Interrupt handlers, events and errors share the same state machine
+void I2C1_EV_IRQHandler (void) { ServiceTransfer(&state[0]); }
+void I2C1_ER_IRQHandler (void) { ServiceTransfer(&state[0]); }
+void I2C2_EV_IRQHandler (void) { ServiceTransfer(&state[1]); }
+void I2C2_ER_IRQHandler (void) { ServiceTransfer(&state[1]); }
+void I2C3_EV_IRQHandler (void) { ServiceTransfer(&state[2]); }
+void I2C3_ER_IRQHandler (void) { ServiceTransfer(&state[2]); }
+void I2C4_EV_IRQHandler (void) { ServiceTransfer(&state[3]); }
+void I2C4_ER_IRQHandler (void) { ServiceTransfer(&state[3]); }
+#endif
+// Any controller with a transfer in progress, holding its bus, or
+// waiting for a bus clear
+bool I2C_Busy (void) {
+ for (I2C_State_t *s = state; s < &state[4]; s++)
+ if (s->cur != NULL || s->held != -1 || s->stuck != NULL)
+ return true;
+ return false;
+}
+// Called from main loop while busy, bounds the time any transfer can take
+// and clears buses left stuck by an error
+void ServiceI2CRequests (void) {
+ uint32_t primask = __get_PRIMASK();
+ __disable_irq();
+ for (I2C_State_t *s = state; s < &state[4]; s++) {
+#ifdef I2C_POLLED
+ // Polling implementation, one state machine step per tick
+ if (s->cur != NULL)
+ ServiceTransfer(s);
+#endif
+ if (s->cur != NULL && TimePassed(s->since) > I2C_TIMEOUT_MS) {
+ // Target stretching the clock or bus stuck, give up on the transfer
+ s->cur->status = I2C_TIMEOUT;
+ s->stuck = s->cur->bus;
+ s->held = -1;
+ EndTransfer(s);
+ }
+ else if (s->cur == NULL && s->held != -1 && TimePassed(s->since) > I2C_TIMEOUT_MS) {
+ // Second half of a write/read pair never came, release the bus
+ s->held = -1;
+ s->iface->CR2 |= I2C_CR2_STOP;
+ StartNext(s);
+ }
+ if (s->cur != NULL || s->held != -1 || s->stuck != NULL)
+ SysTickWake(TimeNow() + 1); // Keep ticking while the bus is in use
+ }
+ __set_PRIMASK(primask);
+ // Bus clear outside the critical section; the controller is held in
+ // reset meanwhile and nothing new starts on it
+ for (I2C_State_t *s = state; s < &state[4]; s++)
+ if (s->stuck != NULL) {
+ ClearBus(s->stuck);
+ __disable_irq();
+ s->stuck = NULL;
+ if (s->cur == NULL)
+ StartNext(s); // Requests that came in meanwhile
+ __set_PRIMASK(primask);
+ }
+}
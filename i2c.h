@@ -0,0 +1,90 @@
+/*
+ * i2c.h
+ *
+ *  Created on: Oct 6, 2025
+ *      Author: bguer053
+ */
+
+#ifndef I2C_H_
+#define I2C_H_
+
+#include <stdbool.h>
+#include "stm32l5xx.h"
+#include "gpio.h"
+#include "systick.h"
+
+//I2C bus connection
+typedef struct {
+	I2C_TypeDef	*iface; //Interface registers I2C1-I2C3
+	Pin_t	pinSDA; //MCU pin for SDA
+	Pin_t	pinSCL; // MCU pin for SCL
+} I2C_Bus_t;
+
+extern I2C_Bus_t LeafyI2C; //I2C bus on Leafy mainboard
+
+// Transfer priority classes, the highest waiting class goes next
+typedef enum {PRIO_BACKLIGHT=0, PRIO_DISPLAY=1, PRIO_LEDS=2, PRIO_INPUT=3} I2C_Prio_t;
+#define I2C_PRIOS 4
+
+// Transfer outcome
+typedef enum {I2C_OK=0, I2C_NACK=1, I2C_ARLO=2, I2C_BERR=3, I2C_TIMEOUT=4, I2C_REPLACED=5} I2C_Status_t;
+
+// Scatter-gather segment, sent back-to-back with the others of a transfer
+typedef struct {
+	uint8_t	*data; // Pointer to data buffer
+	int	size; // Number of bytes in buffer
+} I2C_Seg_t;
+
+// I2C transfer record
+// A read with regSize > 0 is a combined transfer: the register address is
+// written, then the data is read after a repeated START, as one queued unit.
+// A "latest" write requested while still queued is not queued twice; while on
+// the bus it is sent once more; and it takes the place of another latest write
+// queued to the same device with the same key bytes (which ends I2C_REPLACED).
+typedef struct I2C_Xfer_t {
+	I2C_Bus_t	*bus; // Pointer to I2C bus structure
+	uint8_t	addr; // 7-bit target address and read/write bit
+	uint8_t	*data; // Pointer to data buffer
+	int	size; //Total number of bytes in transfer
+	bool	stop; //Whether or not to issue a STOP condition
+	volatile bool	busy; // Busy indicator (queued or in progress), cleared by ISR
+	struct I2C_Xfer_t *next; // Pointer to next transfer in queue
+	void	(*done)(struct I2C_Xfer_t *p); // Completion callback, runs in ISR (optional)
+	I2C_Prio_t	prio; // Priority class (default lowest)
+	uint8_t	*reg; // Register address written before reading data (combined transfer)
+	int	regSize; // Register address bytes, 0 for a plain read or write
+	volatile I2C_Status_t	status; // Outcome, valid once busy is cleared
+	Time_t	queued; // Time of request, for statistics
+	bool	latest; // Latest value wins: requesting again while queued updates in place
+	uint8_t	keySize; // Leading data bytes naming the register, for latest value wins
+	const I2C_Seg_t	*segs; // Segments used instead of data/size when nSegs > 0
+	int	nSegs; // Number of segments
+} I2C_Xfer_t;
+
+void I2C_Enable(I2C_Bus_t bus); //Enable I2C bus Connection
+void I2C_Request(I2C_Xfer_t *p); //Request a new transfer
+void I2C_SetSpeed(I2C_Bus_t bus, uint32_t rate); //Select bus rate in Hz (100k, 400k, 1M)
+void I2C_SetClock(uint32_t kernelHz); //Kernel clock changed, recompute timings
+uint32_t I2C_Timing(uint32_t kernelHz, uint32_t rate); //TIMINGR value for a bus rate
+
+// Bus usage statistics for one target device (times in ms, service in CPU cycles)
+typedef struct {
+	uint8_t	addr; // 7-bit target address
+	uint32_t	transfers; // Completed transfers
+	uint32_t	bytes; // Bytes moved by successful transfers
+	uint32_t	errors; // Transfers ending in NACK, bus error or timeout
+	uint32_t	waitTime; // Total time spent queued before starting
+	uint64_t	serviceCycles; // Total CPU cycles from START to completion
+	uint32_t	maxLatency; // Worst time from request to completion
+} I2C_Stats_t;
+#define I2C_STATS_DEVICES 8 // Number of target devices tracked
+#define I2C_STATS_OTHER 0xFF // Address of the last slot, shared by devices without one
+
+int I2C_GetStats(I2C_Stats_t *snap); //Copy statistics, returns number of devices
+void I2C_ResetStats(void); //Clear all statistics
+void I2C_DumpStats(void); //Print statistics over ITM (debug.c)
+
+bool I2C_Busy(void); //Any transfer in progress or bus held
+void ServiceI2CRequests(void); //Called from main loop, times out stuck transfers
+
+#endif /* I2C_H_ */
@@ -17,11 +17,15 @@
  */
 
 // Standard library headers
+#include <stddef.h>
+#include <inttypes.h>
 #include <stdio.h>
 // Device driver headers
 #include "systick.h"
 #include "i2c.h"
 #include "gpio.h"
+#include "profile.h"
+#include "sched.h"
 // App headers
 #include "alarm.h"
 #include "game.h"
@@ -29,6 +33,57 @@
 #include "touchpad.h"
 #include "calc.h"
 
+// Execution time of each task and of a scheduler pass, in CPU cycles
+#define TICK_CYCLES 4000 // 1ms with 4MHz clock
+enum {PROF_ALARM, PROF_GAME, PROF_CALC, PROF_TIMERS, PROF_IOX, PROF_DISPLAY,
+ PROF_TOUCH, PROF_I2C, PROF_LOOP, PROFS};
+static Profile_t prof[PROFS] = {
+ [PROF_ALARM] = {.name = "Alarm", .budget = TICK_CYCLES},
+ [PROF_GAME] = {.name = "Game", .budget = TICK_CYCLES},
+ [PROF_CALC] = {.name = "Calc", .budget = TICK_CYCLES},
+ [PROF_TIMERS] = {.name = "Timers", .budget = TICK_CYCLES},
+ [PROF_IOX] = {.name = "IOX", .budget = TICK_CYCLES},
+ [PROF_DISPLAY] = {.name = "Display", .budget = TICK_CYCLES},
+ [PROF_TOUCH] = {.name = "Touchpad", .budget = TICK_CYCLES},
+ [PROF_I2C] = {.name = "I2C", .budget = TICK_CYCLES},
+ [PROF_LOOP] = {.name = "Loop", .budget = TICK_CYCLES} };
+// Timer callbacks due, otherwise ask to wake for the next one
+static bool TimersDue (void) {
+ Time_t at;
+ if (!TimerNext(&at))
+ return false;
+ if ((int)(TimeNow() - at) >= 0)
+ return true;
+ SysTickWake(at);
+ return false;
+}
+// Tasks: function, period (ms, 0 every pass), priority, ready predicate, profile.
+// Apps first, housekeeping after so it sees their requests in the same pass,
+// the I2C service last.
+static Task_t tasks[] = {
+ {Task_Alarm, 1, 0, Ready_Alarm, &prof[PROF_ALARM]},
+ {Task_Game, 1, 0, Ready_Game, &prof[PROF_GAME]},
+ {Task_Calc, 1, 0, Ready_Calc, &prof[PROF_CALC]},
+ {ServiceTimers, 0, 1, TimersDue, &prof[PROF_TIMERS]},
+ {UpdateIOExpanders, 1, 1, IOExpandersReady, &prof[PROF_IOX]},
+ {UpdateDisplay, DISPLAY_FRAME_MS, 1, DisplayReady, &prof[PROF_DISPLAY]},
+ {ScanTouchpad, 1, 1, TouchReady, &prof[PROF_TOUCH]},
+ {ServiceI2CRequests, 0, 2, I2C_Busy, &prof[PROF_I2C]} };
+#define TASKS (sizeof(tasks) / sizeof(tasks[0]))
+// Print profiles over ITM now and then, with the runs each task started
+// late and the passes that overran their tick since reset
+#define PROFILE_DUMP_MS 10000
+static Timer_t profTimer;
+static void CallbackProfileDump (Timer_t *t) {
+ (void)t;
+ ProfileDump(prof, PROFS);
+ ProfileReset(prof, PROFS);
+ printf("task          late\n");
+ for (size_t i = 0; i < TASKS; i++)
+ printf("%-10s %7" PRIu32 "\n", tasks[i].prof->name, tasks[i].late);
+ printf("pass overruns %" PRIu32 "\n", SchedOverruns());
+}
+
 int main (void)
 {
  // Initialize apps
@@ -37,16 +92,13 @@ int main (void)
  Init_Calc();
  // Enable services
  StartSysTick();
+ ProfileEnable();
+ TimerStart(&profTimer, PROFILE_DUMP_MS, PROFILE_DUMP_MS, CallbackProfileDump);
+ for (size_t i = 0; i < TASKS; i++)
+ SchedAdd(&tasks[i]);
  while (1) {
- // Run apps
- Task_Alarm();
- Task_Game();
- Task_Calc();
- // Housekeeping
- UpdateIOExpanders();
- UpdateDisplay();
- ScanTouchpad();
- ServiceI2CRequests();
- WaitForSysTick();
+ // Run the tasks that are due and have work, then sleep until the next
+ PROFILE(&prof[PROF_LOOP], SchedRun()); // Excludes idle time
+ SysTickIdle();
  }
 }
@@ -0,0 +1,55 @@
+/*
+ * profile.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: bguer053
+ */
+
+// Execution time profiling with the DWT cycle counter
+#include <stdint.h>
+#include "profile.h"
+#ifdef __arm__
+#include "stm32l5xx.h"
+#else
+#include <time.h>
+#endif
+// Start the cycle counter
+void ProfileEnable (void) {
+#ifdef __arm__
+ CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Enable trace and debug blocks
+ DWT->CYCCNT = 0;
+ DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+// Current cycle count, wraps around; host builds count nanoseconds
+uint32_t ProfileCycles (void) {
+#ifdef __arm__
+ return DWT->CYCCNT;
+#else
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#endif
+}
+// Mark the start of a measured call
+void ProfileBegin (Profile_t *p) {
+ p->start = ProfileCycles();
+}
+// Mark the end of a measured call and account its duration
+void ProfileEnd (Profile_t *p) {
+ uint32_t cycles = ProfileCycles() - p->start;
+ if (p->calls == 0 || cycles < p->min)
+ p->min = cycles;
+ if (cycles > p->max)
+ p->max = cycles;
+ p->total += cycles;
+ p->calls++;
+ if (p->budget != 0 && cycles > p->budget)
+ p->overruns++;
+}
+// Clear the results of n profiles, keeping names, budgets and a running
+// measurement
+void ProfileReset (Profile_t *p, int n) {
+ for (int i = 0; i < n; i++)
+ p[i] = (Profile_t){p[i].name, p[i].budget, .start = p[i].start};
+}
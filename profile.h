@@ -0,0 +1,35 @@
+/*
+ * profile.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: bguer053
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+
+// Execution time of a piece of code, in CPU cycles (nanoseconds on host)
+typedef struct {
+	const char	*name;
+	uint32_t	budget; // Cycles allowed per call, 0 for no limit
+	uint32_t	calls;
+	uint32_t	min;
+	uint32_t	max;
+	uint64_t	total; // For the average
+	uint32_t	overruns; // Calls exceeding budget
+	uint32_t	start; // Cycle count at ProfileBegin
+} Profile_t;
+
+// Measure a call
+#define PROFILE(p, call) do { ProfileBegin(p); call; ProfileEnd(p); } while (0)
+
+void ProfileEnable(void);
+uint32_t ProfileCycles(void);
+void ProfileBegin(Profile_t *p);
+void ProfileEnd(Profile_t *p);
+void ProfileReset(Profile_t *p, int n);
+void ProfileDump(const Profile_t *p, int n); // Defined in debug.c
+
+#endif /* PROFILE_H_ */
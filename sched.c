@@ -0,0 +1,73 @@
+/*
+ * sched.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: bguer053
+ */
+
+// Cooperative task scheduler
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sched.h"
+static Task_t *tasks = NULL; // Registered tasks in priority order
+static uint32_t overruns = 0; // Passes that ran into the next tick
+// Register a task, first run on the next pass
+void SchedAdd (Task_t *t) {
+ Task_t **p = &tasks;
+ while (*p != NULL && (*p)->prio <= t->prio)
+ p = &(*p)->link;
+ t->next = TimeNow();
+ t->link = *p;
+ *p = t;
+}
+// Run a task, measured when it has a profile
+static void RunTask (Task_t *t) {
+ if (t->prof != NULL)
+ PROFILE(t->prof, t->run());
+ else
+ t->run();
+}
+// Called from main loop: one pass over the tasks that are due and have
+// work, then ask tickless idle to wake for the earliest next run
+void SchedRun (void) {
+ Time_t start = TimeNow();
+ Time_t wake = start + 1;
+ bool waking = false;
+ for (Task_t *t = tasks; t != NULL; t = t->link) {
+ Time_t now = TimeNow();
+ if (t->period != 0 && (int)(now - t->next) < 0) {
+ // Not due yet
+ if (!waking || (int)(t->next - wake) < 0)
+ wake = t->next;
+ waking = true;
+ continue;
+ }
+ if (t->ready != NULL && !t->ready()) {
+ t->next = now; // Idle is not late, due again from now
+ continue; // Nothing to do, an interrupt will bring work
+ }
+ RunTask(t);
+ if (t->period == 0) {
+ wake = start + 1; // Runs every pass
+ waking = true;
+ continue;
+ }
+ if (TimePassed(t->next) >= t->period) {
+ t->late++;
+ t->next = now; // Don't try to catch up on missed runs
+ }
+ t->next += t->period;
+ if (!waking || (int)(t->next - wake) < 0)
+ wake = t->next;
+ waking = true;
+ }
+ if (TimePassed(start) >= 1)
+ overruns++;
+ if (waking)
+ SysTickWake(wake);
+}
+// Number of passes that did not finish within the tick they started in
+uint32_t SchedOverruns (void) {
+ return overruns;
+}
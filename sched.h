@@ -0,0 +1,32 @@
+/*
+ * sched.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: bguer053
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "systick.h"
+#include "profile.h"
+
+// Cooperative task, owned by the module that registers it
+typedef struct Task_t {
+	void	(*run)(void);
+	Time_t	period; // ms between runs, 0 for every pass
+	int	prio; // Lower value runs first within a pass
+	bool	(*ready)(void); // Task has work, NULL if always
+	Profile_t	*prof; // Execution time, NULL if not profiled
+	Time_t	next; // Time of next run
+	uint32_t	late; // Runs started a period or more after they were due
+	struct Task_t	*link; // Next task in priority order
+} Task_t;
+
+void SchedAdd(Task_t *t);
+void SchedRun(void);
+uint32_t SchedOverruns(void);
+
+#endif /* SCHED_H_ */
@@ -1,49 +1,263 @@
-/*
- * systick.c
- *
- *  Created on: Sep 22, 2025
- *      Author: bguer053
- */
-
-// Manage the system timer
-#include "systick.h"
-#define SYSTICKS 4000 // 1ms with 4MHz clock
-static volatile Time_t sysTime = 0;
-void StartSysTick() {
-sysTime = 0;
-SysTick->LOAD = (uint32_t)(SYSTICKS - 1); // Set reload register value
-SCB->SHPR[12+SysTick_IRQn] = 7 << 5; // Set interrupt priority
-SysTick->VAL = 0;
-SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk |
- SysTick_CTRL_TICKINT_Msk |
- SysTick_CTRL_ENABLE_Msk;
-}
-// Interrupt handler
-void SysTick_Handler (void) {
-sysTime++;
-}
-// Wait for system time to change
-void WaitForSysTick (void) {
-int wasTime = sysTime;
-while (sysTime == wasTime)
-// Instruction to keep CPU asleep until next interrupt
- __asm volatile ("wfi");
-}
-// Delay measured in milliseconds
-void msDelay (int t) {
-for (int i = 0; i < t; i++)
-WaitForSysTick();
-}
-// Obtain the current system time
-Time_t TimeNow (void) {
-return sysTime;
-}
-// Calculate the elapsed system time since a previous event
-Time_t TimePassed (Time_t since) {
-Time_t now = sysTime;
-if (now >= since)
-return now - since;
-else // Deal with rollover
-return now + 1 + TIME_MAX - since;
-}
-
+/*
+ * systick.c
+ *
+ *  Created on: Sep 22, 2025
+ *      Author: bguer053
+ */
+
+// Manage the system timer
+#include <stddef.h>
+#include <stdbool.h>
+#include "systick.h"
+#define SYSTICKS 4000 // 1ms with 4MHz clock
+static volatile Time_t sysTime = 0;
+// Tickless idle: while sleeping, one SysTick period spans several ms
+#define SLEEP_MAX (int)((SysTick_LOAD_RELOAD_Msk + 1) / SYSTICKS) // Longest period in ms
+static volatile Time_t tickMs = 1; // ms counted by the next SysTick interrupt
+static volatile bool restart = false; // Period other than 1ms running
+static Time_t wakeTime; // Earliest wake-up requested for this pass
+static bool wakeSet = false; // A wake-up time has been requested
+static volatile bool notified = false; // An interrupt brought work since the last idle
+void StartSysTick() {
+sysTime = 0;
+SysTick->LOAD = (uint32_t)(SYSTICKS - 1); // Set reload register value
+SCB->SHPR[12+SysTick_IRQn] = 7 << 5; // Set interrupt priority
+SysTick->VAL = 0;
+SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk |
+ SysTick_CTRL_TICKINT_Msk |
+ SysTick_CTRL_ENABLE_Msk;
+}
+// Interrupt handler
+void SysTick_Handler (void) {
+sysTime += tickMs;
+tickMs = 1;
+if (restart) {
+// Back to 1ms periods after a long or shortened one; the counter has
+// already reloaded the old period, so start a new one
+restart = false;
+SysTick->LOAD = SYSTICKS - 1;
+SysTick->VAL = 0;
+}
+}
+// Wait for system time to change
+void WaitForSysTick (void) {
+int wasTime = sysTime;
+while (sysTime == wasTime)
+// Instruction to keep CPU asleep until next interrupt
+ __WFI();
+}
+// Delay measured in milliseconds
+void msDelay (int t) {
+for (int i = 0; i < t; i++)
+WaitForSysTick();
+}
+// Obtain the current system time
+Time_t TimeNow (void) {
+return sysTime;
+}
+// Calculate the elapsed system time since a previous event
+Time_t TimePassed (Time_t since) {
+Time_t now = sysTime;
+if (now >= since)
+return now - since;
+else // Deal with rollover
+return now + 1 + TIME_MAX - since;
+}
+// Request a wake-up from SysTickIdle no later than the given time
+void SysTickWake (Time_t at) {
+if (!wakeSet || (int)(at - wakeTime) < 0)
+wakeTime = at;
+wakeSet = true;
+}
+// Called from interrupt handlers that hand work to the main loop, so the
+// next SysTickIdle does not sleep past it
+void SysTickNotify (void) {
+notified = true;
+}
+// Sleep until the earliest requested wake-up or any interrupt, with the
+// SysTick reprogrammed for the whole interval instead of ticking every ms.
+// Without a request it waits for the next ms tick, as WaitForSysTick.
+void SysTickIdle (void) {
+Time_t ms = 1;
+if (wakeSet) {
+int left = wakeTime - sysTime;
+ms = left < 1 ? 1 : left > SLEEP_MAX ? SLEEP_MAX : left;
+}
+wakeSet = false;
+if (ms == 1 || tickMs != 1) { // Or a 2ms period is still running
+WaitForSysTick();
+return;
+}
+__disable_irq(); // Interrupts still wake the core, handled below
+if (notified) {
+// Work came in after the main loop looked for it: its interrupt has
+// been taken already and would not end the sleep, run another pass
+notified = false;
+__enable_irq();
+return;
+}
+SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+uint32_t part = SysTick->VAL; // Counts left in the current ms
+if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+// Tick already due, let it be handled
+SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+__enable_irq();
+return;
+}
+if (part == 0)
+part = SysTick->LOAD + 1; // Period just restarted, reload on the next count
+// Rest of this ms and ms-1 more in one period
+uint32_t load = part + (ms - 1) * SYSTICKS;
+SysTick->LOAD = load - 1;
+SysTick->VAL = 0;
+tickMs = ms;
+restart = true;
+SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+__WFI();
+SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+// When the whole period passed, the handler counts it and restarts 1ms
+// periods as soon as interrupts are enabled
+if (!(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)) {
+// Woken early by another interrupt, count the whole ms that passed
+// and finish the current one with a shortened period
+uint32_t val = SysTick->VAL;
+uint32_t done = val == 0 ? 0 : load - val; // Counts since VAL was cleared
+Time_t passed = 0;
+uint32_t rest = part - done; // Counts left of the first ms
+if (done >= part) {
+passed = 1 + (done - part) / SYSTICKS;
+rest = SYSTICKS - (done - part) % SYSTICKS;
+}
+sysTime += passed;
+tickMs = 1;
+if (rest == 1) {
+// LOAD of 0 would stop the counter, run into the next ms instead
+rest += SYSTICKS;
+tickMs = 2;
+}
+SysTick->LOAD = rest - 1;
+SysTick->VAL = 0;
+}
+SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+__enable_irq(); // Pending interrupts are handled now
+}
+// --------------------------------------------------------
+// Timer wheel
+// --------------------------------------------------------
+// Three levels of 64 slots: 1ms, 64ms and 4096ms per slot. A timer sits
+// in the slot of its expiry time at the finest level that covers it and
+// moves down a level when the wheel reaches its slot. Timers further out
+// than the top level wait in its last slot and are placed again.
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 3
+static Timer_t *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static Time_t wheelTime = 0; // Last ms processed
+// Slot index of a time at a level
+#define WHEEL_SLOT(t, level) (((t) >> (WHEEL_BITS * (level))) & (WHEEL_SLOTS - 1))
+// Put a timer into the slot for its expiry time, counting from the first
+// ms not processed yet (base)
+static void TimerInsert (Timer_t *t, Time_t base) {
+Time_t delta = t->expires - base;
+Time_t at = t->expires;
+int level = 0;
+if ((int)delta < 0) {
+at = base; // Overdue, run as soon as possible
+delta = 0;
+}
+while (level < WHEEL_LEVELS - 1 && delta >= (Time_t)WHEEL_SLOTS << (WHEEL_BITS * level))
+level++;
+if (delta >= (Time_t)WHEEL_SLOTS << (WHEEL_BITS * level))
+at = base + ((Time_t)(WHEEL_SLOTS - 1) << (WHEEL_BITS * level)); // Out of range
+Timer_t **slot = &wheel[level][WHEEL_SLOT(at, level)];
+t->prev = slot;
+t->next = *slot;
+if (*slot != NULL)
+(*slot)->prev = &t->next;
+*slot = t;
+}
+// Take a timer out of its slot
+static void TimerRemove (Timer_t *t) {
+*t->prev = t->next;
+if (t->next != NULL)
+t->next->prev = t->prev;
+t->prev = NULL;
+}
+// Start a timer: callback after delay ms, then every period ms if not 0.
+// Timers are used from the main loop only.
+void TimerStart (Timer_t *t, Time_t delay, Time_t period, void (*callback)(Timer_t *t)) {
+if (t->prev != NULL)
+TimerRemove(t);
+t->expires = TimeNow() + delay;
+t->period = period;
+t->callback = callback;
+TimerInsert(t, wheelTime + 1);
+}
+// Stop a timer, no effect when it is not running
+void TimerStop (Timer_t *t) {
+if (t->prev != NULL)
+TimerRemove(t);
+}
+// Timer waiting to expire
+bool TimerActive (const Timer_t *t) {
+return t->prev != NULL;
+}
+// Move the timers of a slot down to finer levels
+static void TimerCascade (int level) {
+Timer_t *t = wheel[level][WHEEL_SLOT(wheelTime, level)];
+wheel[level][WHEEL_SLOT(wheelTime, level)] = NULL;
+while (t != NULL) {
+Timer_t *next = t->next;
+TimerInsert(t, wheelTime);
+t = next;
+}
+}
+// Earliest time a timer may expire, false if none is running. Timers on
+// the coarser levels report the time they move down, which is earlier.
+bool TimerNext (Time_t *at) {
+bool found = false;
+for (int level = 0; level < WHEEL_LEVELS; level++) {
+int shift = WHEEL_BITS * level;
+for (Time_t i = 1; i <= WHEEL_SLOTS; i++) {
+Time_t t = ((wheelTime >> shift) + i) << shift;
+if (wheel[level][WHEEL_SLOT(t, level)] != NULL) {
+if (!found || (int)(t - *at) < 0)
+*at = t;
+found = true;
+break; // Later slots of this level come later
+}
+}
+}
+return found;
+}
+// Called from main loop, runs the callbacks of expired timers. The wheel
+// goes straight to the next ms with timers to run or move down, so a long
+// time without timers costs no more than a short one.
+void ServiceTimers (void) {
+Time_t now = TimeNow();
+while (wheelTime != now) {
+Time_t at;
+if (!TimerNext(&at) || (int)(at - now) > 0) {
+wheelTime = now; // Nothing up to now
+break;
+}
+wheelTime = at;
+// Entering a new slot of a coarser level, move its timers down
+for (int level = WHEEL_LEVELS - 1; level > 0; level--)
+if ((wheelTime & (((Time_t)1 << (WHEEL_BITS * level)) - 1)) == 0)
+TimerCascade(level);
+Timer_t **slot = &wheel[0][WHEEL_SLOT(wheelTime, 0)];
+while (*slot != NULL) {
+Timer_t *t = *slot;
+TimerRemove(t);
+if (t->period != 0) {
+t->expires += t->period;
+TimerInsert(t, wheelTime + 1);
+}
+t->callback(t);
+}
+}
+Time_t at;
+if (TimerNext(&at))
+SysTickWake(at);
+}
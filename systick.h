@@ -0,0 +1,41 @@
+/*
+ * systick.h
+ *
+ *  Created on: Sep 22, 2025
+ *      Author: bguer053
+ */
+
+#ifndef SYSTICK_H_
+#define SYSTICK_H_
+
+#include <stdbool.h>
+#include "stm32l5xx.h"
+
+typedef unsigned int Time_t;
+#define TIME_MAX (Time_t)(-1)
+
+void StartSysTick();
+void WaitForSysTick();
+void msDelay(int t);
+Time_t TimeNow();
+Time_t TimePassed(Time_t since);
+void SysTickWake(Time_t at);
+void SysTickNotify(void);
+void SysTickIdle(void);
+
+// Software timer, owned by the caller and linked into the timer wheel
+typedef struct Timer_t {
+	struct Timer_t	*next; // Next timer in the same slot
+	struct Timer_t	**prev; // Link pointing at this timer, NULL when stopped
+	Time_t	expires; // Time of next expiry
+	Time_t	period; // Reload period in ms, 0 for one-shot
+	void	(*callback)(struct Timer_t *t); // Called from ServiceTimers
+} Timer_t;
+
+void TimerStart(Timer_t *t, Time_t delay, Time_t period, void (*callback)(Timer_t *t));
+void TimerStop(Timer_t *t);
+bool TimerActive(const Timer_t *t);
+bool TimerNext(Time_t *at);
+void ServiceTimers(void);
+
+#endif /* SYSTICK_H_ */
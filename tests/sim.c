@@ -0,0 +1,543 @@
+/*
+ * sim.c
+ *
+ * Host simulation of the lab board for the driver tests
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "i2c.h"
+
+// --------------------------------------------------------
+// Registers
+// --------------------------------------------------------
+NVIC_Type SimNVIC;
+SCB_Type SimSCB;
+SysTick_Type SimSysTick;
+I2C_TypeDef SimI2C[4];
+RCC_TypeDef SimRCC;
+EXTI_TypeDef SimEXTI;
+SYSCFG_TypeDef SimSYSCFG;
+DMA_TypeDef SimDMA1;
+DMA_Channel_TypeDef SimDMA1Ch[8];
+DMAMUX_Channel_TypeDef SimDMAMUXCh[8];
+uint8_t SimGPIO[8][0x400] __attribute__((aligned(0x10000)));
+// Handlers of the code under test; the I2C and DMA ones are missing in
+// a polled build, the main loop service runs the state machine instead
+void SysTick_Handler(void);
+void EXTI5_IRQHandler(void);
+void EXTI6_IRQHandler(void);
+void I2C1_EV_IRQHandler(void) __attribute__((weak));
+void I2C2_EV_IRQHandler(void) __attribute__((weak));
+void I2C3_EV_IRQHandler(void) __attribute__((weak));
+void I2C4_EV_IRQHandler(void) __attribute__((weak));
+void I2C1_ER_IRQHandler(void) __attribute__((weak));
+void I2C2_ER_IRQHandler(void) __attribute__((weak));
+void I2C3_ER_IRQHandler(void) __attribute__((weak));
+void I2C4_ER_IRQHandler(void) __attribute__((weak));
+void DMA1_Channel1_IRQHandler(void) __attribute__((weak));
+void DMA1_Channel2_IRQHandler(void) __attribute__((weak));
+void DMA1_Channel3_IRQHandler(void) __attribute__((weak));
+void DMA1_Channel4_IRQHandler(void) __attribute__((weak));
+// --------------------------------------------------------
+// Checks
+// --------------------------------------------------------
+static int checks = 0;
+static int failures = 0;
+void SimCheck (bool ok, const char *what, const char *file, int line) {
+ checks++;
+ if (!ok) {
+ failures++;
+ printf("%s:%d: check failed: %s\n", file, line, what);
+ }
+}
+int SimDone (const char *name) {
+ printf("%s: %d checks, %d failed\n", name, checks, failures);
+ return failures != 0;
+}
+// --------------------------------------------------------
+// Core: interrupt mask, SysTick counter and sleep
+// --------------------------------------------------------
+uint64_t simCounts = 0;
+static uint32_t primask = 0;
+static uint64_t wakeAt = UINT64_MAX; // Clock of the next other interrupt
+// Take the SysTick interrupt when it is pending and not masked
+static void SimInterrupts (void) {
+ if (primask == 0 && (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)) {
+ SCB->ICSR &= ~SCB_ICSR_PENDSTSET_Msk;
+ SysTick_Handler();
+ }
+}
+void __disable_irq (void) {
+ primask = 1;
+}
+void __enable_irq (void) {
+ primask = 0;
+ SimInterrupts();
+}
+uint32_t __get_PRIMASK (void) {
+ return primask;
+}
+void __set_PRIMASK (uint32_t mask) {
+ primask = mask;
+ SimInterrupts();
+}
+// The counter runs down to 0, raises the interrupt, and is reloaded from
+// LOAD on the following clock, before the handler is entered; a reload of
+// 0 stops it for good
+void SimClock (uint64_t counts) {
+ while (counts > 0) {
+ uint32_t val = SysTick->VAL;
+ uint32_t load = SysTick->LOAD & SysTick_LOAD_RELOAD_Msk;
+ if (!(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) || (val == 0 && load == 0)) {
+ simCounts += counts; // Stopped, time passes without counting
+ return;
+ }
+ if (val == 0) {
+ SysTick->VAL = load;
+ simCounts++;
+ counts--;
+ SimInterrupts();
+ continue;
+ }
+ uint64_t step = val < counts ? val : counts;
+ SysTick->VAL = val - step;
+ simCounts += step;
+ counts -= step;
+ if (SysTick->VAL == 0) {
+ SysTick->CTRL |= SysTick_CTRL_COUNTFLAG_Msk;
+ if (SysTick->CTRL & SysTick_CTRL_TICKINT_Msk)
+ SCB->ICSR |= SCB_ICSR_PENDSTSET_Msk;
+ }
+ }
+}
+// Clocks until the SysTick interrupt is taken, one after the counter
+// reaches 0; UINT64_MAX if never
+static uint64_t ToInterrupt (void) {
+ if (!(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) || !(SysTick->CTRL & SysTick_CTRL_TICKINT_Msk))
+ return UINT64_MAX;
+ uint32_t load = SysTick->LOAD & SysTick_LOAD_RELOAD_Msk;
+ if (SysTick->VAL != 0)
+ return SysTick->VAL + 1;
+ return load == 0 ? UINT64_MAX : 2 + (uint64_t)load;
+}
+// Sleep until the SysTick or another interrupt; a pending one ends it at
+// once even while masked, as on the core
+void __WFI (void) {
+ if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && SysTick->VAL == 0)
+ SimClock(1); // Reload before the handler
+ else if (!(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && wakeAt > simCounts) {
+ uint64_t tick = ToInterrupt();
+ uint64_t other = wakeAt == UINT64_MAX ? UINT64_MAX : wakeAt - simCounts;
+ if (tick == UINT64_MAX && other == UINT64_MAX) {
+ SimCheck(false, "sleeping with no interrupt to wake up", __FILE__, __LINE__);
+ exit(SimDone("stopped")); // Would never wake
+ }
+ SimClock(tick < other ? tick : other);
+ }
+ if (wakeAt <= simCounts)
+ wakeAt = UINT64_MAX;
+ SimInterrupts();
+}
+void SimWakeAfter (uint64_t counts) {
+ wakeAt = simCounts + counts;
+}
+void SimTick (int ms) {
+ for (int i = 0; i < ms; i++) {
+ SimClock(SIM_TICK_COUNTS);
+ SimRun();
+ }
+}
+// --------------------------------------------------------
+// I2C controllers and DMA
+// --------------------------------------------------------
+SimPhase_t simLog[SIM_LOG];
+int simPhases = 0;
+int simIrqs = 0;
+int simDmaIrqs = 0;
+int simCpuBytes = 0;
+int simDmaBytes = 0;
+static SimDevice_t *devices[4];
+#define TXDR_EMPTY 0x100 // Not a byte, TXDR was not written
+static void (*const evIrq[4])(void) = {
+ I2C1_EV_IRQHandler, I2C2_EV_IRQHandler, I2C3_EV_IRQHandler, I2C4_EV_IRQHandler };
+static void (*const erIrq[4])(void) = {
+ I2C1_ER_IRQHandler, I2C2_ER_IRQHandler, I2C3_ER_IRQHandler, I2C4_ER_IRQHandler };
+static void (*const dmaIrq[4])(void) = {
+ DMA1_Channel1_IRQHandler, DMA1_Channel2_IRQHandler,
+ DMA1_Channel3_IRQHandler, DMA1_Channel4_IRQHandler };
+#define ERRORS (I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR)
+// Flags that raise an interrupt with the current enables
+static uint32_t Enabled (I2C_TypeDef *i2c) {
+ uint32_t cr1 = i2c->CR1, isr = i2c->ISR, irq = 0;
+ if (cr1 & I2C_CR1_TXIE) irq |= I2C_ISR_TXIS;
+ if (cr1 & I2C_CR1_RXIE) irq |= I2C_ISR_RXNE;
+ if (cr1 & I2C_CR1_TCIE) irq |= I2C_ISR_TC;
+ if (cr1 & I2C_CR1_STOPIE) irq |= I2C_ISR_STOPF;
+ if (cr1 & I2C_CR1_NACKIE) irq |= I2C_ISR_NACKF;
+ if (cr1 & I2C_CR1_ERRIE) irq |= ERRORS;
+ return isr & irq;
+}
+// Raise a status flag and run the interrupt handler, or the main loop
+// service in a polled build, until the flag is dealt with
+static void Raise (int b, uint32_t flag) {
+ I2C_TypeDef *i2c = &SimI2C[b];
+ i2c->ISR |= flag;
+ if (flag == I2C_ISR_TXIS)
+ i2c->TXDR = TXDR_EMPTY;
+ for (int calls = 0; ; calls++) {
+ bool polled = evIrq[b] == NULL;
+ uint32_t pend = polled ? i2c->ISR & flag : Enabled(i2c);
+ if (pend == 0)
+ break;
+ if (calls == 4) {
+ SimCheck(false, "I2C interrupt not cleared by its handler", __FILE__, __LINE__);
+ i2c->ISR &= ~pend;
+ break;
+ }
+ simIrqs++;
+ if (polled)
+ ServiceI2CRequests();
+ else if (pend & ERRORS)
+ erIrq[b]();
+ else
+ evIrq[b]();
+ // Write 1 to clear, data register accesses and START/STOP clear the rest
+ i2c->ISR &= ~i2c->ICR;
+ i2c->ICR = 0;
+ i2c->ISR &= ~I2C_ISR_RXNE;
+ if (i2c->TXDR != TXDR_EMPTY)
+ i2c->ISR &= ~I2C_ISR_TXIS;
+ if (i2c->CR2 & (I2C_CR2_START | I2C_CR2_STOP))
+ i2c->ISR &= ~I2C_ISR_TC;
+ if (polled)
+ i2c->ISR &= ~flag; // The polled service clears on the next START
+ }
+}
+// One byte through the DMA channel of a controller
+static bool DmaMove (int b, uint8_t *byte, bool rd) {
+ I2C_TypeDef *i2c = &SimI2C[b];
+ DMA_Channel_TypeDef *ch = &SimDMA1Ch[b];
+ uint32_t req = 17 + 2 * b + !rd; // I2Cx_RX, I2Cx_TX follows
+ if (!(ch->CCR & DMA_CCR_EN) || ch->CNDTR == 0
+ || (SimDMAMUXCh[b].CCR & DMAMUX_CxCR_DMAREQ_ID_Msk) != req
+ || !(ch->CCR & DMA_CCR_DIR) != rd
+ || ch->CPAR != (uint32_t)(uintptr_t)(rd ? &i2c->RXDR : &i2c->TXDR)) {
+ SimCheck(false, "DMA channel not set up for the transfer", __FILE__, __LINE__);
+ return false;
+ }
+ uint8_t *mem = (uint8_t *)(uintptr_t)ch->CM0AR;
+ if (rd)
+ *mem = *byte;
+ else
+ *byte = *mem;
+ if (ch->CCR & DMA_CCR_MINC)
+ ch->CM0AR++;
+ simDmaBytes++;
+ if (--ch->CNDTR == 0) {
+ SimDMA1.ISR |= DMA_ISR_TCIF1 << (4 * b);
+ if (ch->CCR & DMA_CCR_TCIE) {
+ simDmaIrqs++;
+ dmaIrq[b]();
+ }
+ }
+ return true;
+}
+// Byte to transmit, from the CPU or DMA
+static bool TxByte (int b, uint8_t *byte) {
+ I2C_TypeDef *i2c = &SimI2C[b];
+ if (i2c->CR1 & I2C_CR1_TXDMAEN)
+ return DmaMove(b, byte, false);
+ Raise(b, I2C_ISR_TXIS);
+ if (i2c->TXDR == TXDR_EMPTY) {
+ SimCheck(false, "TXDR not written for TXIS", __FILE__, __LINE__);
+ return false;
+ }
+ *byte = i2c->TXDR;
+ simCpuBytes++;
+ return true;
+}
+// Byte received, to the CPU or DMA
+static void RxByte (int b, uint8_t byte) {
+ I2C_TypeDef *i2c = &SimI2C[b];
+ if (i2c->CR1 & I2C_CR1_RXDMAEN) {
+ DmaMove(b, &byte, true);
+ return;
+ }
+ i2c->RXDR = byte;
+ simCpuBytes++;
+ Raise(b, I2C_ISR_RXNE);
+}
+void SimAttach (int bus, SimDevice_t *d) {
+ d->next = devices[bus];
+ devices[bus] = d;
+}
+void SimFault (SimDevice_t *d, SimReply_t reply, int at) {
+ d->fault = reply;
+ d->faultAt = at;
+}
+// Injected fault for a byte of the phase, once
+static SimReply_t Fault (SimDevice_t *d, int at) {
+ if (d->fault == SIM_ACK || d->faultAt != at)
+ return SIM_ACK;
+ SimReply_t r = d->fault;
+ d->fault = SIM_ACK;
+ return r;
+}
+// Carry out a START written to CR2: address, data bytes, then STOP or TC
+static bool RunPhase (int b) {
+ I2C_TypeDef *i2c = &SimI2C[b];
+ uint32_t cr2 = i2c->CR2;
+ if (!(i2c->CR1 & I2C_CR1_PE) || !(cr2 & I2C_CR2_START))
+ return false;
+ i2c->CR2 = cr2 & ~I2C_CR2_START;
+ i2c->ISR &= ~I2C_ISR_TC;
+ static SimPhase_t spare;
+ SimPhase_t *ph = simPhases < SIM_LOG ? &simLog[simPhases++] : &spare;
+ *ph = (SimPhase_t){b, (cr2 & 0xFE) >> 1, (cr2 & I2C_CR2_RD_WRN) != 0, false, SIM_ACK, 0, {0}, TimeNow()};
+ int size = (cr2 & I2C_CR2_NBYTES_Msk) >> I2C_CR2_NBYTES_Pos;
+ SimDevice_t *d = devices[b];
+ while (d != NULL && d->addr != ph->addr)
+ d = d->next;
+ SimReply_t r = d == NULL ? SIM_NACK : Fault(d, 0);
+ if (r == SIM_ACK && d->start != NULL)
+ d->start(d, ph->rd);
+ for (int k = 0; r == SIM_ACK && k < size; k++) {
+ uint8_t byte = 0xFF;
+ if (!ph->rd) {
+ if (!TxByte(b, &byte)) {
+ r = SIM_HANG;
+ break;
+ }
+ r = Fault(d, k + 1);
+ if (r == SIM_ACK && d->write != NULL)
+ r = d->write(d, byte);
+ }
+ else {
+ r = Fault(d, k + 1);
+ if (r != SIM_ACK)
+ break;
+ if (d->read != NULL)
+ byte = d->read(d);
+ RxByte(b, byte);
+ }
+ if ((r == SIM_ACK || r == SIM_NACK) && ph->n < SIM_LOG_BYTES)
+ ph->data[ph->n++] = byte;
+ }
+ ph->reply = r;
+ switch (r) {
+ case SIM_ACK:
+ if (cr2 & I2C_CR2_AUTOEND) {
+ ph->stop = true;
+ if (d->stop != NULL)
+ d->stop(d);
+ Raise(b, I2C_ISR_STOPF);
+ }
+ else
+ Raise(b, I2C_ISR_TC); // Bus held, repeated START or STOP next
+ break;
+ case SIM_NACK:
+ // Controller sends STOP after a NACK
+ ph->stop = true;
+ if (d != NULL && d->stop != NULL)
+ d->stop(d);
+ Raise(b, I2C_ISR_NACKF);
+ Raise(b, I2C_ISR_STOPF);
+ break;
+ case SIM_BERR:
+ Raise(b, I2C_ISR_BERR);
+ break;
+ case SIM_HANG:
+ break; // Target holds SCL low, the phase never ends
+ }
+ return true;
+}
+void SimRun (void) {
+ for (int guard = 0; ; guard++) {
+ bool busy = false;
+ for (int b = 0; b < 4; b++)
+ busy |= RunPhase(b);
+ if (!busy)
+ return;
+ if (guard == 10000) {
+ SimCheck(false, "I2C buses never go idle", __FILE__, __LINE__);
+ return;
+ }
+ }
+}
+int SimCount (uint8_t addr, bool rd) {
+ int n = 0;
+ for (int i = 0; i < simPhases; i++)
+ if (simLog[i].addr == addr && simLog[i].rd == rd && simLog[i].reply == SIM_ACK)
+ n++;
+ return n;
+}
+// --------------------------------------------------------
+// Devices
+// --------------------------------------------------------
+SimLcd_t simLcd;
+SimRegs_t simBlt, simLeds, simPbs, simPad, simAux;
+#define LCD_BUSY_MS 2 // Clear and Return Home take 1.52 ms
+static void LcdStart (SimDevice_t *d, bool rd) {
+ (void)d;
+ (void)rd;
+ simLcd.state = 0;
+}
+// Run an instruction or store a data byte, unless still busy
+static void LcdExec (SimLcd_t *l, bool rs, uint8_t byte) {
+ if (l->busy && TimePassed(l->busySince) < LCD_BUSY_MS) {
+ l->lost++;
+ return;
+ }
+ l->busy = false;
+ if (rs) {
+ if (l->cg)
+ l->cgram[l->ac++ & 0x3F] = byte;
+ else {
+ l->ddram[l->ac] = byte;
+ l->ac = l->ac == 0x27 ? 0x40 : l->ac == 0x67 ? 0x00 : l->ac + 1;
+ }
+ }
+ else if (byte & 0x80) {
+ l->ac = byte & 0x7F; // Set DDRAM address
+ l->cg = false;
+ }
+ else if (byte & 0x40) {
+ l->ac = byte & 0x3F; // Set CGRAM address
+ l->cg = true;
+ }
+ else if ((byte & 0xF8) == 0x18) {
+ l->shift = (l->shift + ((byte & 0x04) ? 40 - 1 : 1)) % 40; // Display shift
+ l->shifts++;
+ }
+ else if (byte == 0x01 || (byte & 0xFE) == 0x02) {
+ if (byte == 0x01) {
+ memset(l->ddram, ' ', sizeof(l->ddram));
+ l->clears++;
+ }
+ else
+ l->homes++;
+ l->ac = 0;
+ l->cg = false;
+ l->shift = 0;
+ l->busy = true;
+ l->busySince = TimeNow();
+ }
+}
+// Control byte, then one byte (Co = 1) or all the rest (Co = 0)
+static SimReply_t LcdWrite (SimDevice_t *d, uint8_t byte) {
+ SimLcd_t *l = (SimLcd_t *)d;
+ static bool rs;
+ switch (l->state) {
+ case 0:
+ rs = byte & 0x40;
+ l->state = byte & 0x80 ? 1 : 2;
+ break;
+ case 1:
+ LcdExec(l, rs, byte);
+ l->state = 0;
+ break;
+ default:
+ LcdExec(l, rs, byte);
+ break;
+ }
+ return SIM_ACK;
+}
+void SimLcdRow (int row, char *text) {
+ for (int i = 0; i < 16; i++)
+ text[i] = simLcd.ddram[row * 0x40 + (i + simLcd.shift) % 40];
+ text[16] = '\0';
+}
+static void RegsStart (SimDevice_t *d, bool rd) {
+ SimRegs_t *r = (SimRegs_t *)d;
+ r->first = !rd && !r->port;
+ r->n = 0;
+}
+static SimReply_t RegsWrite (SimDevice_t *d, uint8_t byte) {
+ SimRegs_t *r = (SimRegs_t *)d;
+ if (r->first) {
+ r->ptr = byte & 0x7F;
+ r->first = false;
+ }
+ else if (r->n > 0 && !r->autoInc)
+ r->ignored++;
+ else {
+ r->reg[r->ptr] = byte;
+ r->n++;
+ if (r->autoInc)
+ r->ptr = (r->ptr + 1) & 0x7F;
+ }
+ return SIM_ACK;
+}
+static uint8_t RegsRead (SimDevice_t *d) {
+ SimRegs_t *r = (SimRegs_t *)d;
+ uint8_t byte = r->reg[r->ptr];
+ if (r == &simPad && r->ptr <= 1)
+ GPIOB->IDR |= 1 << 6; // Status read, IRQ line released
+ if (r->autoInc)
+ r->ptr = (r->ptr + 1) & 0x7F;
+ return byte;
+}
+static void Regs (SimRegs_t *r, int bus, uint8_t addr, bool autoInc, bool port) {
+ *r = (SimRegs_t){ {addr, RegsStart, RegsWrite, RegsRead, NULL, SIM_ACK, -1, NULL} };
+ r->autoInc = autoInc;
+ r->port = port;
+ SimAttach(bus, &r->dev);
+}
+void SimTouch (uint16_t status) {
+ simPad.reg[0] = status & 0xFF;
+ simPad.reg[1] = status >> 8;
+ GPIOB->IDR &= ~(1 << 6);
+ if (EXTI->IMR1 & 1 << 6) {
+ EXTI->FPR1 |= 1 << 6;
+ EXTI6_IRQHandler();
+ }
+}
+void SimTouchEn (bool down) {
+ if (down)
+ GPIOB->IDR |= 1 << 5;
+ else
+ GPIOB->IDR &= ~(1 << 5);
+ if (EXTI->IMR1 & 1 << 5) {
+ if (down)
+ EXTI->RPR1 |= 1 << 5;
+ else
+ EXTI->FPR1 |= 1 << 5;
+ EXTI5_IRQHandler();
+ }
+}
+void SimReset (void) {
+ memset(&SimNVIC, 0, sizeof(SimNVIC));
+ memset(&SimSCB, 0, sizeof(SimSCB));
+ memset(&SimSysTick, 0, sizeof(SimSysTick));
+ memset(SimI2C, 0, sizeof(SimI2C));
+ memset(&SimRCC, 0, sizeof(SimRCC));
+ memset(&SimEXTI, 0, sizeof(SimEXTI));
+ memset(&SimSYSCFG, 0, sizeof(SimSYSCFG));
+ memset(&SimDMA1, 0, sizeof(SimDMA1));
+ memset(SimDMA1Ch, 0, sizeof(SimDMA1Ch));
+ memset(SimDMAMUXCh, 0, sizeof(SimDMAMUXCh));
+ memset(SimGPIO, 0, sizeof(SimGPIO));
+ GPIOF->IDR = 0x3; // SDA, SCL pulled up
+ GPIOB->IDR = 1 << 6 | 3 << 8; // Touch IRQ line idle, I2C1 on PB8/PB9 pulled up
+ simPhases = simIrqs = simDmaIrqs = simCpuBytes = simDmaBytes = 0;
+ for (int b = 0; b < 4; b++)
+ devices[b] = NULL;
+ simLcd = (SimLcd_t){ {0x3E, LcdStart, LcdWrite, NULL, NULL, SIM_ACK, -1, NULL} };
+ memset(simLcd.ddram, ' ', sizeof(simLcd.ddram));
+ SimAttach(1, &simLcd.dev);
+ Regs(&simBlt, 1, 0x2D, false, false);
+ Regs(&simLeds, 1, 0x38, false, true);
+ Regs(&simPbs, 1, 0x39, false, true);
+ Regs(&simPad, 1, 0x5A, true, false);
+ Regs(&simAux, 0, 0x5A, true, false);
+ simPbs.reg[0] = 0xFF; // Buttons released, active low
+ primask = 0;
+ wakeAt = UINT64_MAX;
+ StartSysTick();
+ SimClock(1); // First reload, ms ticks now fall every SIM_TICK_COUNTS
+}
@@ -0,0 +1,103 @@
+/*
+ * sim.h
+ *
+ * Host simulation of the lab board for the driver tests: core and
+ * peripheral registers in memory, a SysTick counter, the I2C controllers
+ * with their DMA channels, and models of the devices on LeafyI2C.
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32l5xx.h"
+#include "systick.h"
+
+// Test checks, failures are counted and reported by SimDone
+#define CHECK(cond) SimCheck((cond), #cond, __FILE__, __LINE__)
+void SimCheck(bool ok, const char *what, const char *file, int line);
+int SimDone(const char *name);
+
+// Reset the peripherals and devices, start the SysTick and enable LeafyI2C
+void SimReset(void);
+
+// SysTick clock: counts advance the counter, pending interrupts are taken
+// when not masked
+#define SIM_TICK_COUNTS 4000 // SysTick clocks per ms
+extern uint64_t simCounts; // Clocks since the simulation started
+void SimClock(uint64_t counts);
+void SimTick(int ms); // ms of clocks, the I2C buses run in between
+void SimWakeAfter(uint64_t counts); // Another interrupt ends the next __WFI
+
+// I2C bus: a phase is one START (or repeated START) to STOP or turnaround
+typedef enum {SIM_ACK, SIM_NACK, SIM_BERR, SIM_HANG} SimReply_t;
+typedef struct SimDevice_t {
+	uint8_t	addr; // 7-bit address
+	void	(*start)(struct SimDevice_t *d, bool rd);
+	SimReply_t	(*write)(struct SimDevice_t *d, uint8_t byte);
+	uint8_t	(*read)(struct SimDevice_t *d);
+	void	(*stop)(struct SimDevice_t *d);
+	SimReply_t	fault; // Reply injected at byte faultAt of the next phase
+	int	faultAt; // -1 for none, 0 for the address byte
+	struct SimDevice_t	*next;
+} SimDevice_t;
+#define SIM_LOG 512 // Phases kept
+#define SIM_LOG_BYTES 64 // Bytes kept per phase
+typedef struct {
+	int	bus;
+	uint8_t	addr; // 7-bit address
+	bool	rd;
+	bool	stop; // Ended with STOP, otherwise repeated START or bus held
+	SimReply_t	reply; // How the phase ended
+	int	n; // Bytes moved
+	uint8_t	data[SIM_LOG_BYTES];
+	Time_t	time; // TimeNow() at START
+} SimPhase_t;
+extern SimPhase_t simLog[SIM_LOG];
+extern int simPhases;
+extern int simIrqs; // I2C event/error interrupts taken
+extern int simDmaIrqs; // DMA channel interrupts taken
+extern int simCpuBytes; // Data bytes moved through TXDR/RXDR by the CPU
+extern int simDmaBytes; // Data bytes moved by DMA
+void SimAttach(int bus, SimDevice_t *d);
+void SimFault(SimDevice_t *d, SimReply_t reply, int at);
+void SimRun(void); // Run the buses until every controller is idle
+int SimCount(uint8_t addr, bool rd); // Logged phases to/from a device
+
+// LCD controller (0x3E): DDRAM, CGRAM, display shift and busy time
+typedef struct {
+	SimDevice_t	dev;
+	uint8_t	ddram[0x80];
+	uint8_t	cgram[64];
+	int	ac; // Address counter
+	bool	cg; // Address counter points into CGRAM
+	int	shift; // Columns shifted left
+	Time_t	busySince; // Clear/Return Home executing
+	bool	busy;
+	int	state; // Byte expected: 0 control, 1 single byte, 2 data run, 3 command run
+	int	lost; // Bytes ignored while busy
+	int	homes, shifts, clears;
+} SimLcd_t;
+extern SimLcd_t simLcd;
+void SimLcdRow(int row, char *text); // Visible 16 characters
+// Register devices: backlight (0x2D), IO expanders (0x38, 0x39)
+typedef struct {
+	SimDevice_t	dev;
+	uint8_t	reg[0x80];
+	uint8_t	ptr; // Register pointer
+	bool	first; // Next write byte is the register address
+	bool	autoInc; // Pointer advances after each data byte
+	bool	port; // No register address, a single port register
+	int	n; // Data bytes of this phase
+	int	ignored; // Data bytes after the first on a device without auto-increment
+} SimRegs_t;
+extern SimRegs_t simBlt, simLeds, simPbs;
+// Touch sensor (0x5A): registers, auto-increment, IRQ line on PB6
+extern SimRegs_t simPad;
+void SimTouch(uint16_t status); // New touch status, IRQ line pulled low
+void SimTouchEn(bool down); // Touch En button on PB5 pressed or released
+// Register device (0x5A, auto-increment) on I2C1, for tests of a second bus
+extern SimRegs_t simAux;
+
+#endif /* SIM_H_ */
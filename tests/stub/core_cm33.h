@@ -0,0 +1,87 @@
+/*
+ * core_cm33.h
+ *
+ * Host stand-in for the CMSIS Cortex-M33 core header: the core peripherals
+ * the drivers touch are plain structures in memory, and the intrinsics are
+ * routed to the simulator in sim.c.
+ */
+
+#ifndef CORE_CM33_H_
+#define CORE_CM33_H_
+
+#include <stdint.h>
+
+#define __I volatile const
+#define __O volatile
+#define __IO volatile
+#define __IM volatile const
+#define __OM volatile
+#define __IOM volatile
+
+#define __COMPILER_BARRIER() __asm__ volatile ("" ::: "memory")
+
+typedef struct {
+	__IOM uint32_t ISER[16];
+	uint32_t RESERVED0[16];
+	__IOM uint32_t ICER[16];
+	uint32_t RESERVED1[16];
+	__IOM uint32_t ISPR[16];
+	uint32_t RESERVED2[16];
+	__IOM uint32_t ICPR[16];
+	uint32_t RESERVED3[16];
+	__IOM uint32_t IABR[16];
+	uint32_t RESERVED4[16];
+	__IOM uint32_t ITNS[16];
+	uint32_t RESERVED5[16];
+	__IOM uint8_t IPR[496];
+} NVIC_Type;
+
+typedef struct {
+	__IM uint32_t CPUID;
+	__IOM uint32_t ICSR;
+	__IOM uint32_t VTOR;
+	__IOM uint32_t AIRCR;
+	__IOM uint32_t SCR;
+	__IOM uint32_t CCR;
+	__IOM uint8_t SHPR[12];
+} SCB_Type;
+
+#define SCB_ICSR_PENDSTSET_Pos 26U
+#define SCB_ICSR_PENDSTSET_Msk (1UL << SCB_ICSR_PENDSTSET_Pos)
+#define SCB_ICSR_PENDSTCLR_Pos 25U
+#define SCB_ICSR_PENDSTCLR_Msk (1UL << SCB_ICSR_PENDSTCLR_Pos)
+
+typedef struct {
+	__IOM uint32_t CTRL;
+	__IOM uint32_t LOAD;
+	__IOM uint32_t VAL;
+	__IM uint32_t CALIB;
+} SysTick_Type;
+
+#define SysTick_CTRL_COUNTFLAG_Pos 16U
+#define SysTick_CTRL_COUNTFLAG_Msk (1UL << SysTick_CTRL_COUNTFLAG_Pos)
+#define SysTick_CTRL_CLKSOURCE_Pos 2U
+#define SysTick_CTRL_CLKSOURCE_Msk (1UL << SysTick_CTRL_CLKSOURCE_Pos)
+#define SysTick_CTRL_TICKINT_Pos 1U
+#define SysTick_CTRL_TICKINT_Msk (1UL << SysTick_CTRL_TICKINT_Pos)
+#define SysTick_CTRL_ENABLE_Pos 0U
+#define SysTick_CTRL_ENABLE_Msk (1UL)
+#define SysTick_LOAD_RELOAD_Pos 0U
+#define SysTick_LOAD_RELOAD_Msk (0xFFFFFFUL)
+#define SysTick_VAL_CURRENT_Msk (0xFFFFFFUL)
+
+extern NVIC_Type SimNVIC;
+extern SCB_Type SimSCB;
+extern SysTick_Type SimSysTick;
+#define NVIC (&SimNVIC)
+#define SCB (&SimSCB)
+#define SysTick (&SimSysTick)
+
+// Interrupt masking and sleep, modelled by the simulator
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __WFI(void);
+
+#endif /* CORE_CM33_H_ */
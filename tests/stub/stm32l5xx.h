@@ -0,0 +1,73 @@
+/*
+ * stm32l5xx.h
+ *
+ * Host stand-in for the device header: register layouts and bit
+ * definitions come from the real STM32L552 header, the peripheral
+ * instances are redirected to memory owned by sim.c.
+ */
+
+#ifndef STM32L5XX_H_
+#define STM32L5XX_H_
+
+#include "stm32l552xx.h"
+
+extern I2C_TypeDef SimI2C[4];
+extern RCC_TypeDef SimRCC;
+extern EXTI_TypeDef SimEXTI;
+extern SYSCFG_TypeDef SimSYSCFG;
+extern DMA_TypeDef SimDMA1;
+extern DMA_Channel_TypeDef SimDMA1Ch[8];
+extern DMAMUX_Channel_TypeDef SimDMAMUXCh[8];
+// GPIO ports 1 KB apart as on the device, GPIO_PORT_NUM() works on them
+extern uint8_t SimGPIO[8][0x400];
+
+#undef I2C1
+#undef I2C2
+#undef I2C3
+#undef I2C4
+#define I2C1 (&SimI2C[0])
+#define I2C2 (&SimI2C[1])
+#define I2C3 (&SimI2C[2])
+#define I2C4 (&SimI2C[3])
+#undef RCC
+#undef EXTI
+#undef SYSCFG
+#define RCC (&SimRCC)
+#define EXTI (&SimEXTI)
+#define SYSCFG (&SimSYSCFG)
+#undef DMA1
+#undef DMA1_Channel1
+#undef DMA1_Channel2
+#undef DMA1_Channel3
+#undef DMA1_Channel4
+#define DMA1 (&SimDMA1)
+#define DMA1_Channel1 (&SimDMA1Ch[0])
+#define DMA1_Channel2 (&SimDMA1Ch[1])
+#define DMA1_Channel3 (&SimDMA1Ch[2])
+#define DMA1_Channel4 (&SimDMA1Ch[3])
+#undef DMAMUX1_Channel0
+#undef DMAMUX1_Channel1
+#undef DMAMUX1_Channel2
+#undef DMAMUX1_Channel3
+#define DMAMUX1_Channel0 (&SimDMAMUXCh[0])
+#define DMAMUX1_Channel1 (&SimDMAMUXCh[1])
+#define DMAMUX1_Channel2 (&SimDMAMUXCh[2])
+#define DMAMUX1_Channel3 (&SimDMAMUXCh[3])
+#undef GPIOA
+#undef GPIOB
+#undef GPIOC
+#undef GPIOD
+#undef GPIOE
+#undef GPIOF
+#undef GPIOG
+#undef GPIOH
+#define GPIOA ((GPIO_TypeDef *)SimGPIO[0])
+#define GPIOB ((GPIO_TypeDef *)SimGPIO[1])
+#define GPIOC ((GPIO_TypeDef *)SimGPIO[2])
+#define GPIOD ((GPIO_TypeDef *)SimGPIO[3])
+#define GPIOE ((GPIO_TypeDef *)SimGPIO[4])
+#define GPIOF ((GPIO_TypeDef *)SimGPIO[5])
+#define GPIOG ((GPIO_TypeDef *)SimGPIO[6])
+#define GPIOH ((GPIO_TypeDef *)SimGPIO[7])
+
+#endif /* STM32L5XX_H_ */
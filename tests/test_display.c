@@ -0,0 +1,229 @@
+/*
+ * test_display.c
+ *
+ * Display driver against the simulated LCD and backlight
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "display.h"
+
+// Let a frame go by and flush it to the LCD
+static void Frame (void) {
+ SimTick(DISPLAY_FRAME_MS);
+ UpdateDisplay();
+ SimRun();
+}
+// ms at a time, with the timers serviced as in the main loop
+static void Run (int ms) {
+ for (int i = 0; i < ms; i++) {
+ SimTick(1);
+ UpdateDisplay();
+ ServiceTimers();
+ SimRun();
+ }
+}
+// Visible text of an LCD row
+static const char *Row (int row) {
+ static char text[2][17];
+ SimLcdRow(row, text[row]);
+ return text[row];
+}
+// Each line write is confirmed by its callback, so changes keep going
+// out frame after frame
+static void TestLines (void) {
+ int writes = SimCount(0x3E, false);
+ CHECK(simLcd.clears == 1);
+ DisplayPrint(ALARM, 0, "Hello");
+ DisplayPrint(ALARM, 1, "%d apples", 12);
+ Frame();
+ CHECK(strcmp(Row(0), "Hello           ") == 0);
+ CHECK(strcmp(Row(1), "12 apples       ") == 0);
+ CHECK(SimCount(0x3E, false) == writes + 2);
+ for (int i = 0; i < 5; i++) {
+ DisplayPrint(ALARM, 0, "Count %d", i);
+ Frame();
+ char want[17];
+ snprintf(want, sizeof(want), "Count %-10d", i);
+ CHECK(strcmp(Row(0), want) == 0);
+ }
+ CHECK(simLcd.lost == 0);
+}
+// Page text rewritten while its line write is on the bus: the write carries
+// the shadow copy, the newer text follows in the next frame
+static void TestShadow (void) {
+ DisplayPrint(ALARM, 1, "First");
+ SimTick(DISPLAY_FRAME_MS);
+ UpdateDisplay();
+ DisplayPrint(ALARM, 1, "Second");
+ SimRun();
+ CHECK(strcmp(Row(1), "First           ") == 0);
+ Frame();
+ CHECK(strcmp(Row(1), "Second          ") == 0);
+}
+// Backlight: one write per changed channel register, the controller does
+// not auto-increment; blinking toggles only the lit channels
+static void TestBacklight (void) {
+ int writes = SimCount(0x2D, false);
+ DisplayColor(ALARM, CYAN);
+ Frame();
+ CHECK(SimCount(0x2D, false) == writes + 2);
+ CHECK(simBlt.reg[1] == 0x00 && simBlt.reg[2] == 0xFF && simBlt.reg[3] == 0xFF);
+ DisplayColor(ALARM, WHITE);
+ Frame();
+ CHECK(SimCount(0x2D, false) == writes + 3 && simBlt.reg[1] == 0xFF);
+ Frame();
+ CHECK(SimCount(0x2D, false) == writes + 3); // Unchanged, nothing sent
+ DisplayBlink(ALARM, GREEN, 200);
+ Frame();
+ CHECK(SimCount(0x2D, false) == writes + 5);
+ CHECK(simBlt.reg[1] == 0x00 && simBlt.reg[2] == 0xFF && simBlt.reg[3] == 0x00);
+ for (int i = 0; i < 3; i++)
+ Frame();
+ CHECK(SimCount(0x2D, false) == writes + 6 && simBlt.reg[2] == 0x00); // Dark half
+ // Phases 100 ms apart on average: toggles at the frames after 200, 300,
+ // ... 1100 ms, not every fourth frame
+ for (int i = 0; i < 30; i++)
+ Frame();
+ CHECK(SimCount(0x2D, false) == writes + 16);
+ CHECK(simBlt.ignored == 0);
+ DisplayColor(ALARM, OFF);
+ Frame();
+}
+// Scrolling moves the window with shift commands; stopping it returns home,
+// and the new text waits until the LCD has finished
+static void TestScroll (void) {
+ int shifts = simLcd.shifts;
+ DisplayScroll(ALARM, 100);
+ DisplayPrint(ALARM, 0, "Scrolling text that is wider than the LCD");
+ DisplayPrint(ALARM, 1, "%-40s", "");
+ // One shift in the first frame at or after 100 and 200 ms (132 and 231)
+ bool onTime = true;
+ for (int i = 1; i <= 9; i++) {
+ Frame();
+ onTime &= simLcd.shifts - shifts == i * DISPLAY_FRAME_MS / 100;
+ }
+ CHECK(onTime && simLcd.shifts - shifts == 2);
+ CHECK(strcmp(Row(0), "rolling text tha") == 0);
+ DisplayScroll(ALARM, 0);
+ DisplayPrint(ALARM, 0, "Stopped");
+ Frame();
+ CHECK(simLcd.homes == 1 && simLcd.shift == 0);
+ Frame();
+ CHECK(strcmp(Row(0), "Stopped         ") == 0);
+ CHECK(simLcd.lost == 0);
+ // Back and forth within a frame: home and new text in the same call
+ DisplayScroll(ALARM, 33);
+ Frame();
+ Frame();
+ DisplayScroll(ALARM, 0);
+ DisplayPrint(ALARM, 0, "Home again");
+ SimTick(DISPLAY_FRAME_MS);
+ UpdateDisplay();
+ SimRun();
+ SimTick(1);
+ UpdateDisplay();
+ SimRun();
+ CHECK(strcmp(Row(0), "Stopped         ") == 0); // Held while the LCD is busy
+ Frame();
+ CHECK(strcmp(Row(0), "Home again      ") == 0);
+ CHECK(simLcd.homes == 2 && simLcd.lost == 0);
+}
+// Frame counters: a frame whose changes exceed the byte budget is counted
+// as dropped, the rest goes out in the next one
+static void TestFrames (void) {
+ uint32_t total, dropped, total0, dropped0;
+ DisplayFrames(&total0, &dropped0);
+ DisplayColor(ALARM, WHITE); // Three backlight channels
+ DisplayPrint(ALARM, 0, "ABCDEFGHIJKLMNOP");
+ DisplayPrint(ALARM, 1, "abcdefghijklmnop");
+ Frame();
+ DisplayFrames(&total, &dropped);
+ CHECK(total == total0 + 1 && dropped == dropped0 + 1);
+ CHECK(strcmp(Row(0), "ABCDEFGHIJKLMNOP") == 0 && strcmp(Row(1), "abcdefghijklmnop") != 0);
+ Frame();
+ DisplayFrames(&total, &dropped);
+ CHECK(total == total0 + 2 && dropped == dropped0 + 1);
+ CHECK(strcmp(Row(1), "abcdefghijklmnop") == 0);
+ DisplayColor(ALARM, OFF);
+ Frame();
+}
+// Glyph slots shown anywhere are never replaced, the fallback character is
+// handed out when all eight are in use
+static void TestGlyphs (void) {
+ static Glyph_t g[10];
+ uint8_t code[10];
+ for (int i = 0; i < 10; i++)
+ for (int r = 0; r < 8; r++)
+ g[i].rows[r] = (i * 8 + r) & 0x1F;
+ for (int i = 0; i < 8; i++)
+ code[i] = DisplayGlyph(&g[i]);
+ DisplayPrint(ALARM, 0, "%c%c%c%c", code[0], code[1], code[2], code[3]);
+ DisplayPrint(CALC, 0, "%c%c%c%c", code[4], code[5], code[6], code[7]); // Page not shown
+ for (int i = 0; i < 3; i++)
+ Frame(); // Four uploads fit in a frame
+ for (int i = 0; i < 8; i++) {
+ CHECK(code[i] >= 8 && code[i] < 16);
+ CHECK(memcmp(&simLcd.cgram[(code[i] & 7) * 8], g[i].rows, 8) == 0);
+ }
+ CHECK(Row(0)[0] == code[0] && Row(0)[3] == code[3]);
+ CHECK(DisplayGlyph(&g[8]) == GLYPH_NONE);
+ CHECK(DisplayGlyph(&g[5]) == code[5]); // Still loaded
+ // Slots of glyphs no longer printed anywhere are free again, least
+ // recently used first
+ DisplayPrint(CALC, 0, "%c", code[5]);
+ code[8] = DisplayGlyph(&g[8]);
+ code[9] = DisplayGlyph(&g[9]);
+ CHECK(code[8] == code[4] && code[9] == code[6]);
+ DisplayPrint(ALARM, 1, "%c%c", code[8], code[9]);
+ Frame();
+ CHECK(memcmp(&simLcd.cgram[(code[8] & 7) * 8], g[8].rows, 8) == 0);
+ CHECK(memcmp(&simLcd.cgram[(code[0] & 7) * 8], g[0].rows, 8) == 0); // Shown, kept
+ CHECK(Row(1)[0] == code[8] && Row(1)[1] == code[9]);
+ CHECK(simLcd.lost == 0);
+ DisplayPrint(ALARM, 0, " ");
+ DisplayPrint(ALARM, 1, " ");
+ DisplayPrint(CALC, 0, " ");
+ Frame();
+}
+// Touch En button: bounces shorter than the debounce time are ignored,
+// a settled press and release moves to the next page
+static void TestPages (void) {
+ Page_t page = GetPage();
+ for (int i = 0; i < 5; i++) {
+ SimTouchEn(true);
+ Run(3);
+ SimTouchEn(false);
+ Run(3);
+ }
+ Run(100);
+ CHECK(GetPage() == page);
+ SimTouchEn(true); // Bouncing press, then held
+ Run(2);
+ SimTouchEn(false);
+ Run(1);
+ SimTouchEn(true);
+ Run(100);
+ CHECK(GetPage() == page);
+ SimTouchEn(false);
+ Run(20);
+ CHECK(GetPage() == page); // Switches once the release has settled
+ Run(40);
+ CHECK(GetPage() == (page + 1) % PAGES);
+}
+
+int main (void) {
+ SimReset();
+ DisplayEnable();
+ SimRun();
+ TestLines();
+ TestShadow();
+ TestScroll();
+ TestBacklight();
+ TestFrames();
+ TestGlyphs();
+ TestPages();
+ return SimDone("display");
+}
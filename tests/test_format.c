@@ -0,0 +1,94 @@
+/*
+ * test_format.c
+ *
+ * DisplayPrint formatting against the C library's vsnprintf, and the time
+ * each takes per line
+ */
+
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include "sim.h"
+#include "display.h"
+
+extern uint8_t dispText[PAGES][2][41];
+#define PAGE ((Page_t)3) // Page that is never shown
+#define LINE_COLS 40
+
+// Line printed by DisplayPrint against the library's output, cut at
+// LINE_COLS and padded with spaces
+static void Compare (const char *lib, int lineNo) {
+ char want[LINE_COLS + 1], got[LINE_COLS + 1];
+ snprintf(want, sizeof(want), "%-40.40s", lib);
+ memcpy(got, dispText[PAGE][0], LINE_COLS);
+ got[LINE_COLS] = '\0';
+ if (strcmp(want, got) != 0)
+ printf("want \"%s\"\n got \"%s\"\n", want, got);
+ SimCheck(strcmp(want, got) == 0, "same as vsnprintf", __FILE__, lineNo);
+}
+#define SAME(...) do { \
+ char lib_[256]; \
+ snprintf(lib_, sizeof(lib_), __VA_ARGS__); \
+ DisplayPrint(PAGE, 0, __VA_ARGS__); \
+ Compare(lib_, __LINE__); \
+} while (0)
+
+static void TestConversions (void) {
+ SAME("Plain text");
+ SAME("%d %d %d", 0, 7, -7);
+ SAME("%d %d", INT_MAX, INT_MIN);
+ SAME("%i|%5d|%-5d|%05d", 42, 42, 42, 42);
+ SAME("%5d|%-5d|%05d|", -42, -42, -42);
+ SAME("%3d|%1d|%02d", 12345, -9, -9);
+ SAME("%u %u %lu %ld", 0u, UINT_MAX, 123456ul, -123456l);
+ SAME("%x %X %x %X", 0u, 0xDEADBEEFu, 0xABCu, 0x1Fu);
+ SAME("%08x|%-8X|%2x", 0xBEEFu, 0xBEEFu, 0x12345u);
+ SAME("%c%c%c|%3c|%-3c|", 'a', 'b', 'c', 'x', 'y');
+ SAME("%s|%10s|%-10s|%2s", "abc", "right", "left", "long");
+ SAME("%s", "");
+ SAME("100%% %d%%", 5);
+ SAME("%02d:%02d:%02d", 9, 5, 0);
+ // Cut at the end of the line, also in the middle of a conversion
+ SAME("0123456789012345678901234567890123456789 beyond");
+ SAME("%38s%d", "", 12345);
+ SAME("%-39s%s", "x", "more text");
+}
+
+// Timing of a typical clock/counter line, DisplayPrint against vsnprintf
+static int Lib (char *buf, const char *fmt, ...) {
+ va_list args;
+ va_start(args, fmt);
+ int n = vsnprintf(buf, LINE_COLS + 1, fmt, args);
+ va_end(args);
+ return n;
+}
+static double Now (void) {
+ struct timespec t;
+ clock_gettime(CLOCK_MONOTONIC, &t);
+ return t.tv_sec * 1e9 + t.tv_nsec;
+}
+static void Benchmark (void) {
+ enum { RUNS = 200000 };
+ char buf[LINE_COLS + 1];
+ double t0 = Now();
+ for (int i = 0; i < RUNS; i++)
+ DisplayPrint(PAGE, 0, "%02d:%02d:%02d %5u %-6s%x", i % 24, i % 60, i % 59, i, "alarm", i);
+ double t1 = Now();
+ int sum = 0;
+ for (int i = 0; i < RUNS; i++)
+ sum += Lib(buf, "%02d:%02d:%02d %5u %-6s%x", i % 24, i % 60, i % 59, i, "alarm", i);
+ double t2 = Now();
+ CHECK(sum > 0);
+ printf("format: DisplayPrint %.0f ns, vsnprintf %.0f ns per line (host)\n",
+ (t1 - t0) / RUNS, (t2 - t1) / RUNS);
+}
+
+int main (void) {
+ DisplayScroll(PAGE, 250); // Full LINE_COLS wide lines
+ TestConversions();
+ Benchmark();
+ return SimDone("format");
+}
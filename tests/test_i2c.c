@@ -0,0 +1,526 @@
+/*
+ * test_i2c.c
+ *
+ * I2C transfer engine against the simulated controller, built with and
+ * without DMA and in polled mode
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "i2c.h"
+
+// Completed transfers in the order their callbacks ran
+static I2C_Xfer_t *doneList[16];
+static int doneCount;
+static void CallbackDone (I2C_Xfer_t *p) {
+ if (doneCount < 16)
+ doneList[doneCount++] = p;
+}
+// Write to auto-incrementing registers, the first byte is the register
+static void TestWrite (void) {
+ static uint8_t tx[3] = {0x41, 0x0C, 0x06};
+ static I2C_Xfer_t w = {.bus = &LeafyI2C, .addr = 0xB4, .data = tx, .size = 3, .stop = true,
+ .done = CallbackDone, .prio = PRIO_INPUT};
+ simPhases = doneCount = 0;
+ I2C_Request(&w);
+ CHECK(w.busy);
+ SimRun();
+ CHECK(!w.busy);
+ CHECK(w.status == I2C_OK);
+ CHECK(doneCount == 1 && doneList[0] == &w);
+ CHECK(simPhases == 1);
+ CHECK(simLog[0].addr == 0x5A && !simLog[0].rd && simLog[0].stop);
+ CHECK(simLog[0].n == 3 && memcmp(simLog[0].data, tx, 3) == 0);
+ CHECK(simPad.reg[0x41] == 0x0C && simPad.reg[0x42] == 0x06);
+ CHECK(!I2C_Busy());
+}
+// Register address written, then read back after a repeated START
+static void TestCombinedRead (void) {
+ static uint8_t reg[1] = {0x00};
+ static uint8_t rx[2];
+ static I2C_Xfer_t r = {.bus = &LeafyI2C, .addr = 0xB5, .data = rx, .size = 2, .stop = true,
+ .done = CallbackDone, .prio = PRIO_INPUT, .reg = reg, .regSize = 1};
+ simPhases = doneCount = 0;
+ simPad.reg[0] = 0x34;
+ simPad.reg[1] = 0x02;
+ I2C_Request(&r);
+ SimRun();
+ CHECK(r.status == I2C_OK && !r.busy);
+ CHECK(rx[0] == 0x34 && rx[1] == 0x02);
+ CHECK(simPhases == 2);
+ CHECK(!simLog[0].rd && !simLog[0].stop && simLog[0].n == 1 && simLog[0].data[0] == 0x00);
+ CHECK(simLog[1].rd && simLog[1].stop && simLog[1].n == 2);
+ CHECK(doneCount == 1);
+}
+// Requests queued while the bus is busy drain back to back in order,
+// within the ms they were queued, without help from the main loop
+static void TestQueue (void) {
+ static uint8_t leds[3] = {0x01, 0x02, 0x03};
+ static I2C_Xfer_t w[3];
+ simPhases = doneCount = 0;
+ Time_t queued = TimeNow();
+ for (int i = 0; i < 3; i++) {
+ w[i] = (I2C_Xfer_t){.bus = &LeafyI2C, .addr = 0x70, .data = &leds[i], .size = 1, .stop = true,
+ .done = CallbackDone, .prio = PRIO_LEDS};
+ I2C_Request(&w[i]);
+ }
+ SimRun();
+ CHECK(doneCount == 3);
+ for (int i = 0; i < 3 && i < doneCount; i++) {
+ CHECK(doneList[i] == &w[i]);
+ CHECK(simLog[i].addr == 0x38 && simLog[i].data[0] == leds[i]);
+ CHECK(simLog[i].time == queued);
+ }
+ CHECK(simLeds.reg[0] == 0x03);
+}
+// Long transfers are moved by DMA: the CPU only sees the switch to the
+// next segment and the end of the transfer
+static void TestDma (void) {
+ static uint8_t head[3] = {0x80, 0x80, 0x40};
+ static uint8_t text[16] = "Moved by the DMA";
+ static I2C_Seg_t segs[2] = { {head, 3}, {text, 16} };
+ static I2C_Xfer_t w = {.bus = &LeafyI2C, .addr = 0x7C, .stop = true, .done = CallbackDone,
+ .prio = PRIO_DISPLAY, .segs = segs, .nSegs = 2};
+ char row[17];
+ simPhases = doneCount = simIrqs = simDmaIrqs = simCpuBytes = simDmaBytes = 0;
+ I2C_Request(&w);
+ SimRun();
+ CHECK(doneCount == 1 && w.status == I2C_OK);
+ CHECK(simPhases == 1 && simLog[0].n == 19);
+ SimLcdRow(0, row);
+ CHECK(strcmp(row, "Moved by the DMA") == 0);
+#if !defined(I2C_POLLED) && !defined(I2C_NO_DMA)
+ CHECK(simDmaBytes == 19 && simCpuBytes == 0);
+ CHECK(simDmaIrqs == 1); // Segment reload
+ CHECK(simIrqs == 1); // STOP
+#else
+ CHECK(simCpuBytes == 19 && simDmaBytes == 0);
+#endif
+}
+// Scatter-gather: empty segments are skipped, single-byte segments follow
+// each other, and a combined read fills separate buffers
+static void TestSegments (void) {
+ static uint8_t reg[2] = {0x20, 0x21};
+ static uint8_t data[10] = {0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9};
+ static I2C_Seg_t gaps[5] = { {NULL, 0}, {reg, 1}, {data, 0}, {data, 9}, {NULL, 0} };
+ static I2C_Seg_t small[4] = { {NULL, 0}, {reg, 1}, {NULL, 0}, {data, 2} };
+ static I2C_Seg_t bytes[10];
+ static uint8_t rdReg[1] = {0x20};
+ static uint8_t rx1[3], rx2[12];
+ static I2C_Seg_t rxSegs[2] = { {rx1, 3}, {rx2, 12} };
+ static I2C_Xfer_t w = {.bus = &LeafyI2C, .addr = 0xB4, .stop = true, .done = CallbackDone,
+ .prio = PRIO_INPUT};
+ static I2C_Xfer_t r = {.bus = &LeafyI2C, .addr = 0xB5, .stop = true, .done = CallbackDone,
+ .prio = PRIO_INPUT, .reg = rdReg, .regSize = 1, .segs = rxSegs, .nSegs = 2};
+ // Empty segments at the start, middle and end
+ simPhases = doneCount = simDmaIrqs = 0;
+ w.segs = gaps;
+ w.nSegs = 5;
+ I2C_Request(&w);
+ SimRun();
+ CHECK(w.status == I2C_OK && simPhases == 1 && simLog[0].n == 10);
+ CHECK(simLog[0].data[0] == 0x20 && memcmp(&simLog[0].data[1], data, 9) == 0);
+ CHECK(simPad.reg[0x20] == 0xA0 && simPad.reg[0x28] == 0xA8);
+ // Below the DMA threshold, moved by the CPU through the same segments
+ w.segs = small;
+ w.nSegs = 4;
+ I2C_Request(&w);
+ SimRun();
+ CHECK(w.status == I2C_OK && simLog[1].n == 3 && simLog[1].data[2] == 0xA1);
+ // One byte per segment
+ for (int i = 0; i < 10; i++)
+ bytes[i] = (I2C_Seg_t){i == 0 ? &reg[1] : &data[10 - i], 1};
+ w.segs = bytes;
+ w.nSegs = 10;
+ simDmaIrqs = 0;
+ I2C_Request(&w);
+ SimRun();
+ CHECK(w.status == I2C_OK && simLog[2].n == 10);
+ CHECK(simPad.reg[0x21] == 0xA9 && simPad.reg[0x29] == 0xA1);
+#if !defined(I2C_POLLED) && !defined(I2C_NO_DMA)
+ CHECK(simDmaIrqs == 9); // A reload for every segment after the first
+#endif
+ // Register read scattered over two buffers
+ for (int i = 0; i < 15; i++)
+ simPad.reg[0x20 + i] = 0x60 + i;
+ I2C_Request(&r);
+ SimRun();
+ CHECK(r.status == I2C_OK && simPhases == 5 && simLog[4].rd && simLog[4].n == 15);
+ CHECK(rx1[0] == 0x60 && rx1[2] == 0x62 && rx2[0] == 0x63 && rx2[11] == 0x6E);
+ CHECK(doneCount == 4);
+}
+// Write/read pair kept together: the read queued from the first half's
+// callback goes next, ahead of another class already waiting
+static uint8_t pairReg[1] = {0x00};
+static uint8_t pairData[2];
+static I2C_Xfer_t pairRead = {.bus = &LeafyI2C, .addr = 0xB5, .data = pairData, .size = 2,
+ .stop = true, .done = CallbackDone, .prio = PRIO_INPUT};
+static void CallbackPairWrite (I2C_Xfer_t *p) {
+ CallbackDone(p);
+ I2C_Request(&pairRead);
+}
+static void TestPairs (void) {
+ static uint8_t led = 0x55;
+ static I2C_Xfer_t leds = {.bus = &LeafyI2C, .addr = 0x70, .data = &led, .size = 1, .stop = true,
+ .done = CallbackDone, .prio = PRIO_LEDS};
+ static I2C_Xfer_t pairWrite = {.bus = &LeafyI2C, .addr = 0xB4, .data = pairReg, .size = 1,
+ .stop = false, .done = CallbackPairWrite, .prio = PRIO_INPUT};
+ simPhases = doneCount = 0;
+ I2C_Request(&pairWrite);
+ I2C_Request(&leds);
+ SimRun();
+ CHECK(doneCount == 3);
+ CHECK(doneList[0] == &pairWrite && doneList[1] == &pairRead && doneList[2] == &leds);
+ CHECK(simPhases == 3 && !simLog[0].stop && simLog[1].rd && simLog[2].addr == 0x38);
+ // First half without its second: the waiting class gets the bus at once
+ pairWrite.done = CallbackDone;
+ simPhases = doneCount = 0;
+ I2C_Request(&pairWrite);
+ SimRun();
+ CHECK(I2C_Busy()); // Held for the read
+ I2C_Request(&leds);
+ SimRun();
+ CHECK(doneCount == 2 && doneList[1] == &leds);
+ CHECK(simPhases == 2 && simLog[1].addr == 0x38);
+ CHECK(TimePassed(leds.queued) == 0);
+ CHECK(!I2C_Busy());
+}
+// Faults: an address or data NACK ends the transfer and the bus moves on
+static void TestNack (void) {
+ static uint8_t tx[2] = {0x41, 0x00};
+ static I2C_Xfer_t absent = {.bus = &LeafyI2C, .addr = 0x22, .data = tx, .size = 2, .stop = true,
+ .done = CallbackDone, .prio = PRIO_INPUT};
+ static I2C_Xfer_t w = {.bus = &LeafyI2C, .addr = 0xB4, .data = tx, .size = 2, .stop = true,
+ .done = CallbackDone, .prio = PRIO_INPUT};
+ simPhases = doneCount = 0;
+ I2C_Request(&absent);
+ SimFault(&simPad.dev, SIM_NACK, 1);
+ I2C_Request(&w);
+ SimRun();
+ CHECK(doneCount == 2 && doneList[0] == &absent && doneList[1] == &w);
+ CHECK(absent.status == I2C_NACK && w.status == I2C_NACK);
+ CHECK(simPhases == 2 && simLog[0].stop && simLog[1].stop);
+ I2C_Request(&w);
+ SimRun();
+ CHECK(w.status == I2C_OK);
+ CHECK(!I2C_Busy());
+ // First half of a pair refused: the STOP after the NACK released the bus,
+ // so it is not held for a second half and other classes go at once
+ static uint8_t led = 0x33;
+ static I2C_Xfer_t half = {.bus = &LeafyI2C, .addr = 0xB4, .data = tx, .size = 1, .stop = false,
+ .done = CallbackDone, .prio = PRIO_INPUT};
+ static I2C_Xfer_t leds = {.bus = &LeafyI2C, .addr = 0x70, .data = &led, .size = 1, .stop = true,
+ .done = CallbackDone, .prio = PRIO_LEDS};
+ simPhases = doneCount = 0;
+ SimFault(&simPad.dev, SIM_NACK, 1);
+ I2C_Request(&half);
+ SimRun();
+ CHECK(half.status == I2C_NACK && simLog[0].stop);
+ CHECK(!I2C_Busy());
+ I2C_Request(&leds);
+ SimRun();
+ CHECK(doneCount == 2 && doneList[1] == &leds && leds.status == I2C_OK);
+ CHECK(simLeds.reg[0] == 0x33 && TimePassed(leds.queued) == 0);
+}
+// Bus error: the bus clear waits for the main loop, then queued requests go
+static void TestBusError (void) {
+ static uint8_t tx[2] = {0x41, 0x00};
+ static uint8_t led = 0x0F;
+ static I2C_Xfer_t w = {.bus = &LeafyI2C, .addr = 0xB4, .data = tx, .size = 2, .stop = true,
+ .done = CallbackDone, .prio = PRIO_INPUT};
+ static I2C_Xfer_t leds = {.bus = &LeafyI2C, .addr = 0x70, .data = &led, .size = 1, .stop = true,
+ .done = CallbackDone, .prio = PRIO_LEDS};
+ simPhases = doneCount = 0;
+ SimFault(&simPad.dev, SIM_BERR, 2);
+ GPIOF->BSRR = 0;
+ I2C_Request(&w);
+ I2C_Request(&leds);
+ SimRun();
+ CHECK(w.status == I2C_BERR && doneCount >= 1 && doneList[0] == &w);
+#ifndef I2C_POLLED
+ CHECK(GPIOF->BSRR == 0); // Not cleared from the interrupt
+ CHECK(leds.busy && I2C_Busy());
+ ServiceI2CRequests();
+ SimRun();
+#endif
+ CHECK(GPIOF->BSRR != 0); // SCL and SDA driven by the bus clear
+ CHECK((GPIOF->MODER & 0xF) == 0xA); // Pins handed back to the controller
+ CHECK(LeafyI2C.iface->CR1 & I2C_CR1_PE);
+ CHECK(doneCount == 2 && doneList[1] == &leds && leds.status == I2C_OK);
+ CHECK(simLeds.reg[0] == 0x0F);
+ CHECK(!I2C_Busy());
+}
+// Target holding SCL low: the main loop times the transfer out, clears
+// the bus and the next request goes
+static void TestTimeout (void) {
+ static uint8_t tx[2] = {0x41, 0x00};
+ static uint8_t led = 0xF0;
+ static I2C_Xfer_t w = {.bus = &LeafyI2C, .addr = 0xB4, .data = tx, .size = 2, .stop = true,
+ .done = CallbackDone, .prio = PRIO_INPUT};
+ static I2C_Xfer_t leds = {.bus = &LeafyI2C, .addr = 0x70, .data = &led, .size = 1, .stop = true,
+ .done = CallbackDone, .prio = PRIO_LEDS};
+ simPhases = doneCount = 0;
+ SimFault(&simPad.dev, SIM_HANG, 1);
+ Time_t start = TimeNow();
+ I2C_Request(&w);
+ I2C_Request(&leds);
+ SimRun();
+ CHECK(w.busy && doneCount == 0);
+ while (I2C_Busy() && TimePassed(start) < 100) {
+ SimTick(1);
+ ServiceI2CRequests();
+ SimRun();
+ }
+ CHECK(w.status == I2C_TIMEOUT && !w.busy);
+ CHECK(TimePassed(start) >= 5 && TimePassed(start) <= 52);
+ CHECK(doneCount == 2 && doneList[1] == &leds && leds.status == I2C_OK);
+ CHECK(simLeds.reg[0] == 0xF0);
+ CHECK(!I2C_Busy());
+}
+// Latest value wins: requested again while on the bus, the newer data goes
+// once more and its outcome replaces that of the failed copy
+static void TestRepeat (void) {
+ static uint8_t tx[2] = {0x41, 0x01};
+ static I2C_Xfer_t w = {.bus = &LeafyI2C, .addr = 0xB4, .data = tx, .size = 2, .stop = true,
+ .done = CallbackDone, .prio = PRIO_INPUT, .latest = true, .keySize = 1};
+ simPhases = doneCount = 0;
+ SimFault(&simPad.dev, SIM_NACK, 2);
+ I2C_Request(&w);
+ tx[1] = 0x02;
+ I2C_Request(&w);
+ SimRun();
+ CHECK(simPhases == 2 && simLog[0].reply == SIM_NACK && simLog[1].reply == SIM_ACK);
+ CHECK(!w.busy && w.status == I2C_OK);
+ CHECK(simPad.reg[0x41] == 0x02);
+}
+// Priority classes: a touch read queued behind a display refresh goes
+// next, after only the transfer already on the bus
+#define BYTE_US 90 // Bus time of a byte and its ACK at 100 kHz
+static uint8_t lineHead[3] = {0x80, 0x80, 0x40};
+static uint8_t lineText[16] = "Display workload";
+static I2C_Seg_t lineSegs[2] = { {lineHead, 3}, {lineText, 16} };
+static uint8_t padReg[1] = {0x00};
+static uint8_t padRx[2];
+static I2C_Xfer_t padRead = {.bus = &LeafyI2C, .addr = 0xB5, .data = padRx, .size = 2, .stop = true,
+ .done = CallbackDone, .prio = PRIO_INPUT, .reg = padReg, .regSize = 1};
+static void TestPriority (void) {
+ enum { N = 4 };
+ static I2C_Xfer_t lines[N];
+ simPhases = doneCount = 0;
+ for (int i = 0; i < N; i++) {
+ lines[i] = (I2C_Xfer_t){.bus = &LeafyI2C, .addr = 0x7C, .stop = true, .done = CallbackDone,
+ .prio = PRIO_DISPLAY, .segs = lineSegs, .nSegs = 2};
+ I2C_Request(&lines[i]);
+ }
+ Time_t queued = TimeNow();
+ I2C_Request(&padRead);
+ SimRun();
+ CHECK(doneCount == N + 1 && padRead.status == I2C_OK);
+ CHECK(doneList[0] == &lines[0] && doneList[1] == &padRead);
+ for (int i = 1; i < N && i + 1 < doneCount; i++)
+ CHECK(doneList[i + 1] == &lines[i]);
+ CHECK(simPhases == N + 2);
+ CHECK(simLog[0].addr == 0x3E && simLog[1].addr == 0x5A && !simLog[1].rd && simLog[2].rd);
+ for (int i = 3; i < simPhases; i++)
+ CHECK(simLog[i].addr == 0x3E);
+ // Waited for one line, not the whole refresh
+ CHECK((simLog[0].n + 1) * BYTE_US <= 1800 && simLog[1].time == queued);
+}
+// Benchmark: display refreshes (two lines and three backlight writes) kept
+// queued while the touch read is requested at the start of each of their
+// transfers in turn; latency is bus time from the request to the START of
+// the read, against what a single FIFO would have made it wait
+static SimDevice_t *benchDev[2];
+static void (*benchStart[2])(SimDevice_t *d, bool rd);
+static int armAt, reqPhase;
+static void CallbackBenchStart (SimDevice_t *d, bool rd) {
+ benchStart[d == benchDev[1]](d, rd);
+ if (armAt-- == 0) {
+ reqPhase = simPhases - 1;
+ I2C_Request(&padRead);
+ }
+}
+static void BenchInput (void) {
+ enum { REFRESHES = 3, XFERS = 5 * REFRESHES };
+ static uint8_t blt[3][2] = { {0x01, 0x10}, {0x02, 0x20}, {0x03, 0x30} };
+ static I2C_Xfer_t work[XFERS];
+ benchDev[0] = &simLcd.dev;
+ benchDev[1] = &simBlt.dev;
+ for (int k = 0; k < 2; k++) {
+ benchStart[k] = benchDev[k]->start;
+ benchDev[k]->start = CallbackBenchStart;
+ }
+ int worst = 0, worstFifo = 0, reads = 0;
+ for (int at = 0; at < XFERS; at++) {
+ simPhases = doneCount = 0;
+ for (int i = 0; i < XFERS; i++) {
+ int c = i % 5;
+ work[i] = c < 2
+ ? (I2C_Xfer_t){.bus = &LeafyI2C, .addr = 0x7C, .stop = true, .prio = PRIO_DISPLAY,
+ .segs = lineSegs, .nSegs = 2}
+ : (I2C_Xfer_t){.bus = &LeafyI2C, .addr = 0x5A, .data = blt[c - 2], .size = 2,
+ .stop = true, .prio = PRIO_BACKLIGHT};
+ I2C_Request(&work[i]);
+ }
+ armAt = at;
+ SimRun();
+ int bytes = 0, fifo = 0;
+ bool started = false;
+ for (int i = reqPhase; i < simPhases; i++) {
+ if (simLog[i].addr == 0x5A)
+ started = true;
+ else {
+ fifo += simLog[i].n + 1;
+ if (!started)
+ bytes += simLog[i].n + 1;
+ }
+ }
+ reads += doneCount == 1 && padRead.status == I2C_OK;
+ worst = bytes > worst ? bytes : worst;
+ worstFifo = fifo > worstFifo ? fifo : worstFifo;
+ }
+ for (int k = 0; k < 2; k++)
+ benchDev[k]->start = benchStart[k];
+ CHECK(reads == XFERS);
+ CHECK(worst == 16 + 3 + 1); // One display line
+ printf("i2c: worst input read latency %d us under a saturated display (FIFO: %d us)\n",
+ worst * BYTE_US, worstFifo * BYTE_US);
+}
+// Statistics: counts per device, service time in cycles, and devices
+// beyond the table counted together under I2C_STATS_OTHER
+static void TestStats (void) {
+ static uint8_t tx[2] = {0x41, 0x00};
+ static I2C_Xfer_t w = {.bus = &LeafyI2C, .addr = 0xB4, .data = tx, .size = 2, .stop = true,
+ .prio = PRIO_INPUT};
+ static I2C_Xfer_t absent[I2C_STATS_DEVICES];
+ I2C_Stats_t snap[I2C_STATS_DEVICES];
+ I2C_ResetStats();
+ CHECK(I2C_GetStats(snap) == 0);
+ I2C_Request(&w);
+ SimRun();
+ SimFault(&simPad.dev, SIM_NACK, 1);
+ I2C_Request(&w);
+ SimRun();
+ CHECK(I2C_GetStats(snap) == 1 && snap[0].addr == 0x5A);
+ CHECK(snap[0].transfers == 2 && snap[0].errors == 1 && snap[0].bytes == 2);
+ CHECK(snap[0].serviceCycles > 0 && snap[0].waitTime == 0 && snap[0].maxLatency == 0);
+ // Six more devices fill the table, the last two share the final slot
+ for (int i = 0; i < I2C_STATS_DEVICES; i++) {
+ absent[i] = (I2C_Xfer_t){.bus = &LeafyI2C, .addr = 0x20 + 2 * i, .data = tx, .size = 2,
+ .stop = true, .prio = PRIO_INPUT};
+ I2C_Request(&absent[i]);
+ SimRun();
+ }
+ CHECK(I2C_GetStats(snap) == I2C_STATS_DEVICES);
+ CHECK(snap[1].addr == 0x10 && snap[6].addr == 0x15 && snap[6].errors == 1);
+ CHECK(snap[7].addr == I2C_STATS_OTHER && snap[7].transfers == 2 && snap[7].errors == 2);
+ I2C_ResetStats();
+}
+// Second controller: each bus has its own queue, the two run side by side
+// and a target hanging one of them leaves the other alone
+static I2C_Bus_t AuxI2C = {I2C1, {GPIOB, 9}, {GPIOB, 8}};
+static void TestTwoBuses (void) {
+ static uint8_t head[3] = {0x80, 0x80, 0x40};
+ static uint8_t text[16] = "Bus 2 and bus 1 ";
+ static I2C_Seg_t segs[2] = { {head, 3}, {text, 16} };
+ static uint8_t block[20] = {0x10, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19};
+ static I2C_Xfer_t lcd = {.bus = &LeafyI2C, .addr = 0x7C, .stop = true, .done = CallbackDone,
+ .prio = PRIO_DISPLAY, .segs = segs, .nSegs = 2};
+ static I2C_Xfer_t aux[3];
+ static I2C_Xfer_t pad = {.bus = &LeafyI2C, .addr = 0xB4, .data = block, .size = 3, .stop = true,
+ .done = CallbackDone, .prio = PRIO_INPUT};
+ simPhases = doneCount = simDmaBytes = simCpuBytes = 0;
+ for (int i = 0; i < 3; i++) {
+ aux[i] = (I2C_Xfer_t){.bus = &AuxI2C, .addr = 0xB4, .data = block, .size = 20, .stop = true,
+ .done = CallbackDone, .prio = PRIO_INPUT};
+ I2C_Request(&aux[i]);
+ }
+ I2C_Request(&lcd);
+ I2C_Request(&pad);
+ Time_t queued = TimeNow();
+ SimRun();
+ CHECK(doneCount == 5);
+ CHECK(simPhases == 5);
+ // Interleaved, the second bus did not wait for the first to drain
+ CHECK(simLog[0].bus != simLog[1].bus && simLog[2].bus != simLog[3].bus);
+ for (int i = 0; i < simPhases; i++)
+ CHECK(simLog[i].time == queued);
+ CHECK(SimCount(0x5A, false) == 4 && SimCount(0x3E, false) == 1);
+ CHECK(simAux.reg[0x10] == 1 && simAux.reg[0x22] == 19);
+ CHECK(simPad.reg[0x10] == 1 && simPad.reg[0x11] == 2 && simPad.reg[0x12] == 0);
+#if !defined(I2C_POLLED) && !defined(I2C_NO_DMA)
+ CHECK(simDmaBytes == 3 * 20 + 19 && simCpuBytes == 3); // Each bus on its own channel
+#endif
+ // A hung target on the second bus, LeafyI2C carries on
+ doneCount = 0;
+ SimFault(&simAux.dev, SIM_HANG, 1);
+ I2C_Request(&aux[0]);
+ I2C_Request(&pad);
+ SimRun();
+ CHECK(aux[0].busy && !pad.busy && pad.status == I2C_OK);
+ for (int ms = 0; ms < 100 && I2C_Busy(); ms++) {
+ SimTick(1);
+ ServiceI2CRequests();
+ SimRun();
+ }
+ CHECK(aux[0].status == I2C_TIMEOUT && !I2C_Busy());
+ I2C_Request(&aux[1]);
+ SimRun();
+ CHECK(aux[1].status == I2C_OK);
+}
+// I/O expanders: the LEDs are written when they change and the buttons
+// read every poll period; in between there is nothing to do
+static void TestExpanders (void) {
+ UpdateIOExpanders();
+ SimRun();
+ CHECK(!IOExpandersReady());
+ int reads = SimCount(0x39, true);
+ GPIOX->ODR = 0x05;
+ CHECK(IOExpandersReady());
+ UpdateIOExpanders();
+ SimRun();
+ CHECK(simLeds.reg[0] == 0xFA && !IOExpandersReady());
+ simPbs.reg[0] = (uint8_t)~0x08; // Button pressed, active low
+ int ms = 0;
+ while (ms < 50 && !IOExpandersReady()) {
+ SimTick(1);
+ ServiceTimers();
+ ms++;
+ }
+ CHECK(ms > 0 && ms <= 20);
+ UpdateIOExpanders();
+ SimRun();
+ CHECK(SimCount(0x39, true) == reads + 1);
+ CHECK(GPIO_PortInput(GPIOX) == 0x08 << 8 && !IOExpandersReady());
+ simPbs.reg[0] = 0xFF;
+}
+
+int main (void) {
+ SimReset();
+ I2C_Enable(LeafyI2C);
+ TestWrite();
+ TestCombinedRead();
+ TestQueue();
+ TestDma();
+ TestSegments();
+ TestPairs();
+ TestNack();
+ TestBusError();
+ TestTimeout();
+ TestRepeat();
+ TestExpanders();
+ TestPriority();
+ BenchInput();
+ TestStats();
+ I2C_Enable(AuxI2C);
+ TestTwoBuses();
+#if defined(I2C_POLLED)
+ return SimDone("i2c (polled)");
+#elif defined(I2C_NO_DMA)
+ return SimDone("i2c (interrupts)");
+#else
+ return SimDone("i2c (interrupts, DMA)");
+#endif
+}
@@ -0,0 +1,78 @@
+/*
+ * test_systick.c
+ *
+ * Tickless idle against the simulated SysTick counter: the ms count must
+ * stay on the 1ms grid whatever count another interrupt wakes it at
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include "sim.h"
+#include "systick.h"
+
+#define MS SIM_TICK_COUNTS
+
+// Sleep for 4 ms, woken after d counts, at every phase of the first two ms
+static void TestEarlyWake (void) {
+ int late = 0, wrong = 0;
+ for (uint32_t d = 0; d <= 2 * MS + 1; d++) {
+ WaitForSysTick();
+ uint64_t t0 = simCounts;
+ Time_t s0 = TimeNow();
+ uint32_t part = SysTick->VAL != 0 ? SysTick->VAL : SysTick->LOAD + 1; // Counts to the next tick
+ SysTickWake(s0 + 4);
+ SimWakeAfter(d);
+ SysTickIdle();
+ CHECK(simCounts == t0 + d);
+ Time_t passed = d < part ? 0 : 1 + (d - part) / MS;
+ uint32_t rest = d < part ? part - d : MS - (d - part) % MS;
+ wrong += TimeNow() != s0 + passed;
+ // The tick ending the ms woken in stays where it was, then 1ms
+ // periods follow; a 1-count rest runs on to the tick after
+ uint64_t tick = t0 + part + 1 + (uint64_t)MS * passed;
+ while (TimeNow() < s0 + passed + 2)
+ WaitForSysTick();
+ late += simCounts != (rest == 1 ? tick + MS : tick + MS + 1) || TimeNow() != s0 + passed + 2;
+ }
+ CHECK(wrong == 0);
+ CHECK(late == 0);
+}
+// Sleep for the whole period: the handler counts it and restores 1ms ticks
+static void TestFullSleep (void) {
+ for (Time_t ms = 2; ms <= 40; ms += 19) {
+ WaitForSysTick();
+ uint64_t t0 = simCounts;
+ Time_t s0 = TimeNow();
+ SysTickWake(s0 + ms);
+ SysTickIdle();
+ CHECK(TimeNow() == s0 + ms);
+ CHECK(simCounts == t0 + (uint64_t)MS * ms);
+ for (int i = 1; i <= 3; i++) {
+ WaitForSysTick();
+ CHECK(TimeNow() == s0 + ms + i);
+ CHECK(simCounts == t0 + (uint64_t)MS * (ms + i) + 1);
+ }
+ }
+}
+// Work handed over by an interrupt just before the sleep: no sleep at all,
+// the notice is used up and the next idle sleeps as requested
+static void TestNotify (void) {
+ WaitForSysTick();
+ uint64_t t0 = simCounts;
+ Time_t s0 = TimeNow();
+ SysTickNotify();
+ SysTickWake(s0 + 10);
+ SysTickIdle();
+ CHECK(simCounts == t0 && TimeNow() == s0);
+ SysTickWake(s0 + 10);
+ SysTickIdle();
+ CHECK(TimeNow() == s0 + 10);
+}
+
+int main (void) {
+ SimReset();
+ TestEarlyWake();
+ TestFullSleep();
+ TestNotify();
+ return SimDone("systick");
+}
@@ -0,0 +1,126 @@
+/*
+ * test_timer.c
+ *
+ * Timer wheel: expiry times at every level, through the wraparound of the
+ * system time
+ */
+
+#include <stdio.h>
+#include "sim.h"
+// Built in, so the test can set the system time and the wheel position
+#include "systick.c"
+
+// Timer with the times it was expected to and did expire
+typedef struct {
+ Timer_t t;
+ Time_t want; // Next expected expiry
+ int fired;
+ int wrong; // Expiries at another time
+} Probe_t;
+static void CallbackProbe (Timer_t *t) {
+ Probe_t *p = (Probe_t *)t;
+ p->wrong += TimeNow() != p->want;
+ p->fired++;
+ p->want += t->period;
+}
+static void Start (Probe_t *p, Time_t delay, Time_t period) {
+ *p = (Probe_t){.want = TimeNow() + delay};
+ TimerStart(&p->t, delay, period, CallbackProbe);
+}
+// Advance the time 1ms at a time, servicing the timers each ms
+static void Run (Time_t ms) {
+ for (Time_t i = 0; i < ms; i++) {
+ sysTime++;
+ ServiceTimers();
+ }
+}
+// Set the system time, with the wheel caught up to it
+static void SetTime (Time_t t) {
+ sysTime = t;
+ wheelTime = t;
+}
+
+// One-shot timers at each level and at the level boundaries, started
+// shortly before the time wraps around
+static void TestWrap (void) {
+ static const Time_t delays[] = {1, 2, 63, 64, 65, 100, 4095, 4096, 4097, 5000,
+  262143, 262144, 300000};
+ enum { N = sizeof(delays) / sizeof(delays[0]) };
+ static Probe_t p[N];
+ SetTime(TIME_MAX - 150);
+ for (int i = 0; i < N; i++)
+ Start(&p[i], delays[i], 0);
+ Time_t at;
+ CHECK(TimerNext(&at) && at == TIME_MAX - 149);
+ Run(300001);
+ int fired = 0, wrong = 0;
+ for (int i = 0; i < N; i++) {
+ fired += p[i].fired;
+ wrong += p[i].wrong;
+ CHECK(!TimerActive(&p[i].t));
+ }
+ CHECK(fired == N && wrong == 0);
+ CHECK(!TimerNext(&at));
+}
+// Periodic timers keep their period across the wraparound, a stopped one
+// never fires again
+static void TestPeriodic (void) {
+ static Probe_t fast, slow, stopped;
+ SetTime(TIME_MAX - 5000);
+ Start(&fast, 7, 7);
+ Start(&slow, 1000, 1000);
+ Start(&stopped, 10, 10);
+ Run(100);
+ TimerStop(&stopped.t);
+ int n = stopped.fired;
+ Run(10000);
+ CHECK(fast.fired == 10100 / 7 && fast.wrong == 0);
+ CHECK(slow.fired == 10 && slow.wrong == 0);
+ CHECK(stopped.fired == n && !TimerActive(&stopped.t));
+ // Restarting a running timer moves it
+ Start(&slow, 3, 0);
+ Run(3);
+ CHECK(slow.fired == 1 && slow.wrong == 0 && !TimerActive(&slow.t));
+ TimerStop(&fast.t);
+}
+// Long gaps between services: the wheel jumps to the next expiry, so the
+// cost is per timer, not per ms; overdue timers run once, in order
+typedef struct {
+ Timer_t t;
+ int id;
+} Tagged_t;
+static int order[4], fires;
+static void CallbackOrder (Timer_t *t) {
+ if (fires < 4)
+ order[fires] = ((Tagged_t *)t)->id;
+ fires++;
+}
+static void TestGap (void) {
+ static Probe_t far;
+ static Tagged_t t[4];
+ SetTime(TIME_MAX - 100000);
+ Start(&far, 250000, 0);
+ sysTime += 249999;
+ ServiceTimers();
+ CHECK(far.fired == 0 && wheelTime == sysTime);
+ Run(1);
+ CHECK(far.fired == 1 && far.wrong == 0);
+ // Started last to first expiry, all overdue by the next service
+ fires = 0;
+ for (int i = 0; i < 4; i++) {
+ t[i].id = i;
+ TimerStart(&t[i].t, 5000 - 1000 * i, 0, CallbackOrder);
+ }
+ sysTime += 6000;
+ ServiceTimers();
+ CHECK(fires == 4 && order[0] == 3 && order[1] == 2 && order[2] == 1 && order[3] == 0);
+ CHECK(wheelTime == sysTime);
+}
+
+int main (void) {
+ SimReset();
+ TestWrap();
+ TestPeriodic();
+ TestGap();
+ return SimDone("timer");
+}
@@ -0,0 +1,90 @@
+/*
+ * test_timing.c
+ *
+ * TIMINGR values against the I2C specification limits for a table of
+ * kernel clocks and bus rates, and retiming of a running bus
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include "sim.h"
+#include "i2c.h"
+
+// Kernel clock, requested rate, whether the clock is fast enough for it
+// (the SCL low/high minimums plus synchronization delays fit the period)
+typedef struct {
+ uint32_t kernelHz;
+ uint32_t rate;
+ bool reach;
+} Case_t;
+static const Case_t cases[] = {
+ { 1000000, 100000, false}, { 2000000, 100000, false}, { 2000000, 400000, false},
+ { 4000000, 100000, true}, { 4000000, 400000, false}, { 4000000, 1000000, false},
+ { 8000000, 100000, true}, { 8000000, 400000, true}, { 8000000, 1000000, false},
+ { 16000000, 100000, true}, { 16000000, 400000, true}, { 16000000, 1000000, false},
+ { 48000000, 100000, true}, { 48000000, 400000, true}, { 48000000, 1000000, true},
+ {110000000, 100000, true}, {110000000, 400000, true}, {110000000, 1000000, true},
+ { 48000000, 2000000, true}, // Above Fast-mode Plus, clamped to 1 MHz
+};
+// Specification limits in ps: tLow, tHigh, tRise, tFall, tSU;DAT, tHD;DAT(max)
+static const uint32_t limits[3][6] = {
+ {4700000, 4000000, 1000000, 300000, 250000, 3450000},
+ {1300000, 600000, 300000, 300000, 100000, 900000},
+ { 500000, 260000, 120000, 120000, 50000, 450000},
+};
+static void TestTable (void) {
+ for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+ const Case_t *c = &cases[i];
+ uint32_t rate = c->rate > 1000000 ? 1000000 : c->rate;
+ const uint32_t *l = limits[rate <= 100000 ? 0 : rate <= 400000 ? 1 : 2];
+ uint32_t t = I2C_Timing(c->kernelHz, c->rate);
+ int64_t tClk = 1000000000000LL / c->kernelHz;
+ int presc = (t & I2C_TIMINGR_PRESC_Msk) >> I2C_TIMINGR_PRESC_Pos;
+ int scldel = (t & I2C_TIMINGR_SCLDEL_Msk) >> I2C_TIMINGR_SCLDEL_Pos;
+ int sdadel = (t & I2C_TIMINGR_SDADEL_Msk) >> I2C_TIMINGR_SDADEL_Pos;
+ int high = ((t & I2C_TIMINGR_SCLH_Msk) >> I2C_TIMINGR_SCLH_Pos) + 1;
+ int low = ((t & I2C_TIMINGR_SCLL_Msk) >> I2C_TIMINGR_SCLL_Pos) + 1;
+ int64_t tPresc = (presc + 1) * tClk;
+ int64_t period = 2 * 50000 + 4 * tClk + (low + high) * tPresc;
+ int64_t actual = 1000000000000LL / period;
+ bool ok = low * tPresc >= l[0] && high * tPresc >= l[1]
+ && (scldel + 1) * tPresc >= l[2] + l[4]
+ && sdadel * tPresc >= (int64_t)l[3] - 50000 - 3 * tClk
+ && (sdadel == 0 || sdadel * tPresc <= (int64_t)l[5] - 260000 - 4 * tClk)
+ && (c->reach ? actual >= rate * 95 / 100 && actual <= rate * 105 / 100 : actual < rate);
+ if (!ok)
+ printf("%lu Hz clock, %lu Hz: TIMINGR %08lx gives %ld Hz\n", (unsigned long)c->kernelHz,
+ (unsigned long)c->rate, (unsigned long)t, (long)actual);
+ CHECK(ok);
+ }
+}
+// A speed or clock change waits for the transfer in progress, then the
+// precomputed value is written
+static void TestRetime (void) {
+ static uint8_t tx[3] = {0x41, 0x0C, 0x06};
+ static I2C_Xfer_t w = {.bus = &LeafyI2C, .addr = 0xB4, .data = tx, .size = 3, .stop = true,
+ .prio = PRIO_INPUT};
+ CHECK(LeafyI2C.iface->TIMINGR == I2C_Timing(4000000, 100000));
+ I2C_SetSpeed(LeafyI2C, 400000);
+ CHECK(LeafyI2C.iface->TIMINGR == I2C_Timing(4000000, 400000));
+ I2C_Request(&w);
+ I2C_SetClock(16000000);
+ CHECK(LeafyI2C.iface->TIMINGR == I2C_Timing(4000000, 400000)); // Bus busy
+ SimRun();
+ CHECK(w.status == I2C_OK);
+ I2C_Request(&w); // Next transfer starts at the new timing
+ SimRun();
+ CHECK(LeafyI2C.iface->TIMINGR == I2C_Timing(16000000, 400000));
+ CHECK(LeafyI2C.iface->CR1 & I2C_CR1_PE);
+ I2C_SetClock(4000000);
+ I2C_SetSpeed(LeafyI2C, 100000);
+ CHECK(LeafyI2C.iface->TIMINGR == I2C_Timing(4000000, 100000));
+}
+
+int main (void) {
+ SimReset();
+ I2C_Enable(LeafyI2C);
+ TestTable();
+ TestRetime();
+ return SimDone("timing");
+}
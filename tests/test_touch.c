@@ -0,0 +1,205 @@
+/*
+ * test_touch.c
+ *
+ * Touchpad driver against the simulated touch sensor and its IRQ line
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "touchpad.h"
+
+// Run the main loop's touchpad service for a number of ms
+static void Scan (int ms) {
+ for (int i = 0; i < ms; i++) {
+ SimTick(1);
+ ServiceTimers();
+ ScanTouchpad();
+ SimRun();
+ }
+ ScanTouchpad(); // Decode the last read
+}
+// Sensor set up by one auto-increment burst from the first baseline filter
+// register through ECR, which goes last and starts the sensor
+static void TestInit (void) {
+ CHECK(SimCount(0x5A, false) == 2); // Burst, then the status register address
+ CHECK(simPhases >= 1 && simLog[0].addr == 0x5A && !simLog[0].rd && simLog[0].stop);
+ CHECK(simLog[0].n == 1 + 0x5E - 0x2B + 1 && simLog[0].data[0] == 0x2B);
+ CHECK(simLog[0].data[simLog[0].n - 1] == 0x8C); // ECR: tracking, 12 electrodes
+ CHECK(simPad.reg[0x5E] == 0x8C);
+ CHECK(simPad.reg[0x2B] == 0x01 && simPad.reg[0x2D] == 0x0E); // Baseline filters
+ for (int n = 0; n <= 12; n++)
+ CHECK(simPad.reg[0x41 + 2*n] == 12 && simPad.reg[0x42 + 2*n] == 6);
+ CHECK(simPad.reg[0x5B] == 0x11 && simPad.reg[0x5C] == 0x10 && simPad.reg[0x5D] == 0x20);
+ CHECK(simLog[1].addr == 0x5A && simLog[1].n == 1 && simLog[1].data[0] == 0x00);
+}
+// Status is read when the IRQ line goes low; with nobody touching the pads
+// only the slow fallback poll remains on the bus
+static void TestIdle (void) {
+ Scan(10);
+ int reads = SimCount(0x5A, true);
+ Scan(1000);
+ int idle = SimCount(0x5A, true) - reads;
+ printf("touch: %d status reads in 1 s idle\n", idle);
+ CHECK(idle >= 9 && idle <= 11); // TOUCH_POLL_MS apart
+ CHECK(GPIOB->IDR & 1 << 6); // IRQ line released
+ // A touch is read within a ms of the edge
+ reads = SimCount(0x5A, true);
+ SimTouch(1 << N3);
+ Scan(1);
+ CHECK(SimCount(0x5A, true) == reads + 1);
+ CHECK(TouchInput(ALARM) == N3);
+ SimTouch(0);
+ Scan(1);
+ TouchEvent_t e;
+ CHECK(TouchEvent(ALARM, &e) && e.kind == TOUCH_RELEASE && e.pad == N3);
+ // Status changed without an edge: the fallback poll catches it
+ simPad.reg[0] = 1 << N7;
+ Scan(100);
+ CHECK(TouchInput(ALARM) == N7);
+ simPad.reg[0] = 0;
+ Scan(100);
+ ClearTouchpad(ALARM);
+}
+// Press and release a pad, one status read each
+static void Tap (Press_t pad) {
+ SimTouch(1 << pad);
+ Scan(1);
+ SimTouch(0);
+ Scan(1);
+}
+// Event queue: a full queue keeps the oldest events and counts the rest,
+// and order holds while the indices wrap around many times
+static void TestQueue (void) {
+ TouchEvent_t e;
+ uint32_t lost = TouchLost();
+ for (int i = 0; i < 20; i++)
+ Tap(i % 10);
+ CHECK(TouchLost() - lost == 2 * 20 - 16);
+ for (int i = 0; i < 8; i++) {
+ CHECK(TouchEvent(ALARM, &e) && e.kind == TOUCH_PRESS && e.pad == i);
+ CHECK(TouchEvent(ALARM, &e) && e.kind == TOUCH_RELEASE && e.pad == i);
+ }
+ CHECK(!TouchEvent(ALARM, &e));
+ // Producer ahead of the consumer by a varying amount, 600 events
+ int next = 0, bad = 0;
+ for (int i = 0; i < 300; i++) {
+ Tap(i % 10);
+ if (i % 7 == 6) // Drain now and then, up to 14 events waiting
+ while (TouchEvent(ALARM, &e)) {
+ bad += e.pad != next / 2 % 10 || e.kind != (next % 2 ? TOUCH_RELEASE : TOUCH_PRESS);
+ next++;
+ }
+ }
+ while (TouchEvent(ALARM, &e)) {
+ bad += e.pad != next / 2 % 10 || e.kind != (next % 2 ? TOUCH_RELEASE : TOUCH_PRESS);
+ next++;
+ }
+ CHECK(next == 600 && bad == 0);
+ CHECK(TouchLost() - lost == 2 * 20 - 16);
+ // Another page's queue is untouched, cleared separately
+ CHECK(!TouchEvent(CALC, &e));
+ Tap(N1);
+ ClearTouchpad(ALARM);
+ CHECK(!TouchEvent(ALARM, &e));
+}
+
+// Gestures timed from the press: long press, auto-repeat at its own rate,
+// and a chord that ends both for the rest of the press
+static void TestGestures (void) {
+ TouchEvent_t e, press;
+ ClearTouchpad(ALARM);
+ // Long press, once, longMs after the press
+ TouchGestures(500, 0, 0);
+ SimTouch(1 << N5);
+ Scan(1);
+ CHECK(TouchEvent(ALARM, &press) && press.kind == TOUCH_PRESS && press.pad == N5);
+ Scan(499);
+ CHECK(!TouchEvent(ALARM, &e));
+ Scan(1000);
+ CHECK(TouchEvent(ALARM, &e) && e.kind == TOUCH_LONG && e.pad == N5);
+ CHECK(e.time - press.time == 500);
+ CHECK(!TouchEvent(ALARM, &e));
+ SimTouch(0);
+ Scan(1);
+ CHECK(TouchEvent(ALARM, &e) && e.kind == TOUCH_RELEASE && e.pad == N5);
+ // Auto-repeat after the delay, then every period
+ TouchGestures(0, 300, 100);
+ SimTouch(1 << N2);
+ Scan(1);
+ CHECK(TouchEvent(ALARM, &press) && press.kind == TOUCH_PRESS);
+ Scan(650);
+ int repeats = 0, late = 0;
+ while (TouchEvent(ALARM, &e) && e.kind == TOUCH_REPEAT && e.pad == N2) {
+ late += e.time - press.time != (Time_t)(300 + 100 * repeats);
+ repeats++;
+ }
+ CHECK(repeats == 4 && late == 0); // At 300, 400, 500 and 600 ms
+ SimTouch(0);
+ Scan(1);
+ ClearTouchpad(ALARM);
+ // Chord: the second pad is reported with the first, and neither long
+ // press nor repeat follow however long both are held
+ TouchGestures(500, 300, 100);
+ SimTouch(1 << N1);
+ Scan(50);
+ SimTouch(1 << N1 | 1 << N4);
+ Scan(1000);
+ CHECK(TouchEvent(ALARM, &e) && e.kind == TOUCH_PRESS && e.pad == N1);
+ CHECK(TouchEvent(ALARM, &e) && e.kind == TOUCH_CHORD && e.pad == N1 && e.pad2 == N4);
+ CHECK(!TouchEvent(ALARM, &e));
+ SimTouch(0);
+ Scan(1);
+ CHECK(TouchEvent(ALARM, &e) && e.kind == TOUCH_RELEASE && e.pad == N1);
+ TouchGestures(1000, 0, 0);
+}
+// Numeric entry: SHIFT erases a digit, holding it for the long press time
+// clears the number
+static void TestEntry (void) {
+ Entry_t num = 0;
+ ClearTouchpad(ALARM);
+ Tap(N4);
+ Tap(N2);
+ while (TouchPending(ALARM))
+ TouchEntry(ALARM, &num);
+ CHECK(num == 42);
+ // Shorter than the long press: only the erase
+ TouchGestures(800, 0, 0);
+ SimTouch(1 << SHIFT);
+ Scan(600);
+ SimTouch(0);
+ Scan(1);
+ while (TouchPending(ALARM))
+ TouchEntry(ALARM, &num);
+ CHECK(num == 4);
+ // Held past it: cleared
+ num = 42;
+ TouchGestures(500, 0, 0);
+ SimTouch(1 << SHIFT);
+ Scan(600);
+ SimTouch(0);
+ Scan(1);
+ while (TouchPending(ALARM))
+ TouchEntry(ALARM, &num);
+ CHECK(num == 0);
+ Tap(N7);
+ Tap(NEXT);
+ bool done = false;
+ while (TouchPending(ALARM) && !done)
+ done = TouchEntry(ALARM, &num);
+ CHECK(done && num == 7);
+ TouchGestures(1000, 0, 0);
+}
+
+int main (void) {
+ SimReset();
+ TouchEnable();
+ SimRun();
+ TestInit();
+ TestIdle();
+ TestQueue();
+ TestGestures();
+ TestEntry();
+ return SimDone("touch");
+}
@@ -1,96 +1,280 @@
-/*
- * touchpad.c
- *
- *  Created on: Nov 3, 2025
- *      Author: knguy138
- */
-
-
-// Touchpad driver
-#include <stddef.h>
-#include <stdint.h>
-#include <stdbool.h>
-#include <stdio.h>
-#include "touchpad.h"
-#include "systick.h"
-#include "i2c.h"
-#include "display.h"
-#include "gpio.h"
-static bool enabled = false;
-// I2C write transfer to initialize Touchpad sensor
-// Electrode Configuration Register (ECR), all 12 electrodes enabled
-static uint8_t txInit[2] = {0x5E, 0x0C}; // Register Adddress, Write Data
-static I2C_Xfer_t PadInit = {&LeafyI2C, 0xB4, txInit, 2, 1, 0, NULL};
-
-// I2C combined write-read transfer to read Touchpad sensor
-// Touch Status Registers (lower and upper)
-static uint8_t txRdAddr[1] = {0x00}; // Register Address (lower)
-static uint8_t rxRdData[2]; // Read Data (2 bytes)
-
-static I2C_Xfer_t PadRdAddr = {&LeafyI2C, 0xB4, txRdAddr, 1, 0, 0, NULL};
-static I2C_Xfer_t PadRdData = {&LeafyI2C, 0xB5, rxRdData, 2, 1, 0, NULL};
-
-// Enable Touchpad driver
-void TouchEnable (void) {
- if (!enabled) {
- enabled = true;
- I2C_Enable(LeafyI2C);
- I2C_Request(&PadInit);
- // Request first read
- I2C_Request(&PadRdAddr);
- I2C_Request(&PadRdData);
- }
-}
-static uint16_t touchData;
-static bool touchCapture = false;
-static Press_t lastPress;
-// Single pad pressed
-Press_t TouchInput (Page_t page) {
- if (page != GetPage())
- return NONE; // Hide input for inactive pages
- Press_t pad = lastPress;
- lastPress = NONE;
- return pad;
-}
-// Ongoing numeric entry
-bool TouchEntry(Page_t page, Entry_t *num) {
- if (page != GetPage())
- return false; // Hide input for inactive pages
- bool done = false;
- if (lastPress >= N0 && lastPress <= N9)
- *num = *num * 10 + lastPress; // Add new digit
- else if (lastPress == SHIFT)
- *num /= 10; // Erase last digit
- else if (lastPress == NEXT)
- done = true; // Entry complete
- lastPress = NONE; // Empty the buffer
- return done;
-}
-// Called from main loop housekeeping to check for Touchpad input
-void ScanTouchpad (void) {
- if (!PadRdData.busy) {
- // Process new data from Touchpad
- touchData = rxRdData[0] | rxRdData[1] << 8;
- // Rising edge detect on touchData
- if (!touchCapture && touchData != 0x0000) {
- for (Press_t n = MIN; n <= MAX; n++)
- // Check each bit for one-hot setting
- if (touchData == 1 << n) {
- // Single pad pressed
- touchCapture = true;
- lastPress = n;
- break; // Stop checking bits
- }
- }
- else if (touchData == 0x0000)
- // Nothing pressed, reset capture state
- touchCapture = false;
- // Request next read
- I2C_Request(&PadRdAddr);
- I2C_Request(&PadRdData);
- }
-}
-// Discard input buffer
-void ClearTouchpad (void) {
- lastPress = NONE;
-}
+/*
+ * touchpad.c
+ *
+ *  Created on: Nov 3, 2025
+ *      Author: knguy138
+ */
+
+
+// Touchpad driver
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "touchpad.h"
+#include "systick.h"
+#include "i2c.h"
+#include "display.h"
+#include "gpio.h"
+static bool enabled = false;
+static void CallbackPadRead(I2C_Xfer_t *p);
+static void CallbackTouchIrq(void);
+static void CallbackPoll(Timer_t *t);
+// The sensor pulls its IRQ line low when the touch status changes and
+// releases it once the status has been read
+static const Pin_t TouchIrq = {GPIOB, 6}; // Pin PB6 <- Touchpad IRQ (active low)
+#define TOUCH_POLL_MS 100 // Fallback read period in case an edge is missed
+static volatile bool touchChanged = true; // IRQ seen since last read
+static Timer_t pollTimer; // Restarted by each read, reads again on expiry
+static volatile bool reading = false; // Read queued, until its callback
+// Sensor tuning, applied by TouchEnable
+static TouchConfig_t touchConfig = {
+ .touch = 12, .release = 6, // Thresholds, out of 255 counts
+ .debounceTouch = 1, .debounceRelease = 1, // Extra samples to confirm
+ .afe1 = 0x10, // 6 first filter samples, 16 uA charge current
+ .afe2 = 0x20, // 0.5 us charge time, 4 second filter samples, 1 ms period
+ .tracking = true };
+// I2C write transfer to initialize Touchpad sensor: all registers from the
+// baseline filters (0x2B) up to the Electrode Configuration Register (0x5E)
+// in one burst, the sensor auto-increments the register address
+#define REG_MHDR 0x2B // First baseline filter register
+#define REG_TTH0 0x41 // Touch threshold of pad 0, release threshold follows
+#define REG_DEBOUNCE 0x5B // Debounce release/touch
+#define REG_ECR 0x5E // Electrode Configuration Register
+#define INIT_BYTES (1 + REG_ECR - REG_MHDR + 1) // Address and registers
+static uint8_t txInit[INIT_BYTES] = {REG_MHDR}; // Register Address, Write Data
+static I2C_Xfer_t PadInit = {.bus = &LeafyI2C, .addr = 0xB4, .data = txInit, .size = INIT_BYTES,
+ .stop = true, .prio = PRIO_INPUT};
+#define INIT_REG(reg) txInit[1 + (reg) - REG_MHDR]
+
+// I2C combined write-read transfer to read Touchpad sensor
+// Touch Status Registers (lower and upper)
+static uint8_t txRdAddr[1] = {0x00}; // Register Address (lower)
+static uint8_t rxRdData[2]; // Read Data (2 bytes)
+
+static I2C_Xfer_t PadRead = {.bus = &LeafyI2C, .addr = 0xB5, .data = rxRdData, .size = 2,
+ .stop = true, .done = CallbackPadRead, .prio = PRIO_INPUT, .reg = txRdAddr, .regSize = 1};
+
+// Set sensor tuning, takes effect when the Touchpad is enabled
+void TouchConfigure (const TouchConfig_t *config) {
+ touchConfig = *config;
+}
+// Fill in the initialization burst from the tuning settings
+static void BuildInit (void) {
+ const TouchConfig_t *c = &touchConfig;
+ if (c->tracking) {
+ // Baseline follows slow drift: rising, falling and touched filters
+ static const uint8_t filters[] = {0x01, 0x01, 0x0E, 0x00, 0x01, 0x05, 0x01, 0x00, 0x00, 0x00, 0x00};
+ for (int i = 0; i < (int)sizeof(filters); i++)
+ INIT_REG(REG_MHDR + i) = filters[i];
+ }
+ for (int n = MIN; n <= MAX + 1; n++) { // Pads and proximity electrode
+ INIT_REG(REG_TTH0 + 2*n) = c->touch;
+ INIT_REG(REG_TTH0 + 2*n + 1) = c->release;
+ }
+ INIT_REG(REG_DEBOUNCE) = c->debounceRelease << 4 | c->debounceTouch;
+ INIT_REG(REG_DEBOUNCE + 1) = c->afe1;
+ INIT_REG(REG_DEBOUNCE + 2) = c->afe2;
+ // Baseline loaded from the first reading (all 10 bits when it stays
+ // fixed), 12 electrodes enabled; written last, starts the sensor
+ INIT_REG(REG_ECR) = (c->tracking ? 0x80 : 0xC0) | 0x0C;
+}
+// Enable Touchpad driver
+void TouchEnable (void) {
+ if (!enabled) {
+ enabled = true;
+ I2C_Enable(LeafyI2C);
+ BuildInit();
+ I2C_Request(&PadInit);
+ // Read status when the sensor signals a change
+ GPIO_Enable(TouchIrq);
+ GPIO_Mode(TouchIrq, INPUT);
+ GPIO_Config(TouchIrq, PP, S0, PU);
+ GPIO_Callback(TouchIrq, CallbackTouchIrq, FALL);
+ // Request first read
+ TimerStart(&pollTimer, TOUCH_POLL_MS, 0, CallbackPoll);
+ reading = true;
+ I2C_Request(&PadRead);
+ }
+}
+static volatile uint16_t touchData; // Latest touch status, one bit per pad
+static volatile bool touchNew = false; // Status read since last decode
+static uint16_t touchPrev = 0x0000; // Status at last decode
+static Press_t capturedPad = NONE; // Pad of the press being captured
+static Page_t capturedPage; // Page open when the press started
+static Time_t capturedTime; // Timestamp of the press
+static bool longSent; // Long press reported for this press
+static bool repeating; // Auto-repeat running for this press
+static Time_t repeatTime; // Timestamp of next auto-repeat
+// Gesture timing in ms, 0 disables
+static Time_t longMs = 1000; // Hold time for a long press
+static Time_t repeatDelay = 0; // Hold time before auto-repeat starts
+static Time_t repeatPeriod = 0; // Time between repeats
+// Touch events of each page, decoded from the status and emptied by the
+// page's task; single producer/single consumer, so no locking is needed
+#define TOUCH_QUEUE 16 // Events per page, power of 2
+typedef struct {
+ TouchEvent_t event[TOUCH_QUEUE];
+ volatile uint8_t head; // Next slot to fill, written by producer only
+ volatile uint8_t tail; // Next slot to empty, written by consumer only
+} TouchQueue_t;
+static TouchQueue_t queue[PAGES];
+static uint32_t touchLost = 0; // Events discarded on a full queue
+// Add an event to a page's queue
+static void PutEvent (Page_t page, TouchKind_t kind, Press_t pad, Press_t pad2) {
+ TouchQueue_t *q = &queue[page];
+ uint8_t head = q->head;
+ if ((uint8_t)(head - q->tail) == TOUCH_QUEUE) {
+ touchLost++;
+ return; // Full, keep the older events
+ }
+ q->event[head % TOUCH_QUEUE] = (TouchEvent_t){pad, kind, TimeNow(), pad2};
+ __COMPILER_BARRIER(); // Event complete before it is published
+ q->head = head + 1;
+}
+// Next touch event of a page, false if there is none
+bool TouchEvent (Page_t page, TouchEvent_t *e) {
+ TouchQueue_t *q = &queue[page];
+ uint8_t tail = q->tail;
+ if (tail == q->head)
+ return false;
+ *e = q->event[tail % TOUCH_QUEUE];
+ __COMPILER_BARRIER(); // Event copied before the slot is released
+ q->tail = tail + 1;
+ return true;
+}
+// Events waiting in a page's queue
+bool TouchPending (Page_t page) {
+ return queue[page].tail != queue[page].head;
+}
+// Set long press and auto-repeat timing in ms, 0 disables
+void TouchGestures (Time_t longPress, Time_t delay, Time_t period) {
+ longMs = longPress;
+ repeatDelay = delay;
+ repeatPeriod = period;
+}
+// Single pad pressed, auto-repeats count as presses
+Press_t TouchInput (Page_t page) {
+ TouchEvent_t e;
+ while (TouchEvent(page, &e))
+ if (e.kind == TOUCH_PRESS || e.kind == TOUCH_REPEAT)
+ return e.pad;
+ return NONE;
+}
+// Ongoing numeric entry
+bool TouchEntry(Page_t page, Entry_t *num) {
+ TouchEvent_t e;
+ while (TouchEvent(page, &e)) {
+ if (e.kind == TOUCH_LONG && e.pad == SHIFT)
+ *num = 0; // Hold SHIFT to clear
+ if (e.kind != TOUCH_PRESS && e.kind != TOUCH_REPEAT)
+ continue;
+ if (e.pad >= N0 && e.pad <= N9)
+ *num = *num * 10 + e.pad; // Add new digit
+ else if (e.pad == SHIFT)
+ *num /= 10; // Erase last digit
+ else if (e.pad == NEXT)
+ return true; // Entry complete
+ break; // One key per call
+ }
+ return false;
+}
+// Lowest pad set in a status word
+static Press_t LowestPad (uint16_t data) {
+ for (Press_t n = MIN; n <= MAX; n++)
+ if (data & 1 << n)
+ return n;
+ return NONE;
+}
+// Turn a change of touch status into events
+static void DecodeTouch (uint16_t data) {
+ uint16_t added = data & ~touchPrev;
+ bool single = (added & (added - 1)) == 0; // At most one pad added
+ if (touchPrev == 0x0000 && data != 0x0000 && single) {
+ // Single pad pressed, input goes to the page open now
+ capturedPad = LowestPad(data);
+ capturedPage = GetPage();
+ capturedTime = TimeNow();
+ longSent = false;
+ repeating = repeatDelay != 0;
+ repeatTime = capturedTime + repeatDelay;
+ PutEvent(capturedPage, TOUCH_PRESS, capturedPad, NONE);
+ }
+ else if (capturedPad != NONE && added != 0 && single
+ && data == (1 << capturedPad | added)) {
+ // Second pad joins the held one, no long press or repeat after this
+ PutEvent(capturedPage, TOUCH_CHORD, capturedPad, LowestPad(added));
+ longSent = true;
+ repeating = false;
+ }
+ else if (data == 0x0000 && capturedPad != NONE) {
+ // Nothing pressed, reset capture state
+ PutEvent(capturedPage, TOUCH_RELEASE, capturedPad, NONE);
+ capturedPad = NONE;
+ }
+ touchPrev = data;
+}
+// Hold gestures of the captured press, from elapsed time only
+static void TimeTouch (void) {
+ if (capturedPad == NONE)
+ return;
+ if (longMs != 0 && !longSent && TimePassed(capturedTime) >= longMs) {
+ longSent = true;
+ PutEvent(capturedPage, TOUCH_LONG, capturedPad, NONE);
+ }
+ if (repeating && (int)(TimeNow() - repeatTime) >= 0) {
+ PutEvent(capturedPage, TOUCH_REPEAT, capturedPad, NONE);
+ repeatTime += repeatPeriod != 0 ? repeatPeriod : repeatDelay;
+ }
+}
+// Called from main loop housekeeping, decodes gestures and reads the
+// Touchpad when its IRQ line signals a change, and now and then in case
+// an edge was missed
+void ScanTouchpad (void) {
+ if (touchNew) {
+ touchNew = false;
+ DecodeTouch(touchData);
+ }
+ TimeTouch();
+ if (reading)
+ return;
+ if (touchChanged || GPIO_Input(TouchIrq) == LOW) {
+ touchChanged = false;
+ TimerStart(&pollTimer, TOUCH_POLL_MS, 0, CallbackPoll);
+ reading = true;
+ I2C_Request(&PadRead); // Request next read
+ }
+}
+// Work for ScanTouchpad: a status read to decode, a press being timed,
+// or the latched IRQ while no read is in progress
+bool TouchReady (void) {
+ return touchNew || capturedPad != NONE || (touchChanged && !reading);
+}
+// Touchpad IRQ line asserted
+static void CallbackTouchIrq (void) {
+ touchChanged = true;
+}
+// No read for TOUCH_POLL_MS, read anyway in case an edge was missed
+static void CallbackPoll (Timer_t *t) {
+ (void)t;
+ touchChanged = true;
+}
+// Called by the I2C driver when a Touchpad read completes
+static void CallbackPadRead (I2C_Xfer_t *p) {
+ reading = false;
+ if (p->status != I2C_OK)
+ return; // Keep previous state, next read will catch up
+ // Process new data from Touchpad in the main loop
+ touchData = rxRdData[0] | rxRdData[1] << 8;
+ touchNew = true;
+}
+// Number of events discarded because a page's queue was full
+uint32_t TouchLost (void) {
+ return touchLost;
+}
+// Discard input buffer of a page
+void ClearTouchpad (Page_t page) {
+ TouchEvent_t e;
+ while (TouchEvent(page, &e))
+ ;
+}
@@ -0,0 +1,57 @@
+/*
+ * touchpad.h
+ *
+ *  Created on: Nov 3, 2025
+ *      Author: knguy138
+ */
+
+#ifndef TOUCHPAD_H_
+#define TOUCHPAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "display.h"
+#include "systick.h"
+
+typedef enum {NONE = -1, MIN = 0, N0=0, N1 =1 , N2 =2 , N3 =3 , N4 =4 , N5 =5 , N6 =6, N7 =7 , N8 =8 , N9 =9, SHIFT=10, NEXT=11, MAX=11  } Press_t;
+
+typedef uint32_t Entry_t;
+
+// Touch sensor tuning
+typedef struct {
+	uint8_t	touch; // Touch threshold
+	uint8_t	release; // Release threshold
+	uint8_t	debounceTouch; // Samples to confirm a touch, 0 to 7
+	uint8_t	debounceRelease; // Samples to confirm a release, 0 to 7
+	uint8_t	afe1; // Filter/global CDC configuration register
+	uint8_t	afe2; // Filter/global CDT configuration register
+	bool	tracking; // Baseline follows slow drift
+} TouchConfig_t;
+
+typedef enum {TOUCH_PRESS, TOUCH_RELEASE, TOUCH_LONG, TOUCH_REPEAT, TOUCH_CHORD} TouchKind_t;
+
+// Touch gesture
+typedef struct {
+	Press_t	pad; // Pad pressed first
+	TouchKind_t	kind;
+	Time_t	time; // TimeNow() when the gesture was detected
+	Press_t	pad2; // Second pad of a chord, otherwise NONE
+} TouchEvent_t;
+
+void TouchConfigure(const TouchConfig_t *config);
+void TouchEnable(void);
+bool TouchEvent(Page_t page, TouchEvent_t *e);
+bool TouchPending(Page_t page);
+void TouchGestures(Time_t longPress, Time_t delay, Time_t period);
+Press_t TouchInput(Page_t page);
+bool TouchEntry(Page_t page, Entry_t *num );
+uint32_t TouchLost(void);
+
+void ScanTouchpad(void);
+bool TouchReady(void);
+void ClearTouchpad(Page_t page);
+
+#endif /* TOUCHPAD_H_ */
+
+
+